@@ -7,14 +7,18 @@
 //
 
 #include "ConnectedComponent.h"
-#include <stdexcept>
+#include "UnionFind.h"
+#include "StripLabeling.h"
+#include "TwoPassLabeling.h"
+#include <climits>
 
 using namespace std;
 using namespace cv;
 
-ConnectedComponent::ConnectedComponent( int max_component, int connectivity_type )
-: maxComponent( max_component ),
-  connectivityType( connectivity_type ){
+ConnectedComponent::ConnectedComponent( Connectivity connectivity_type, bool multi_threaded )
+: connectivityType( connectivity_type ),
+  multiThreaded( multi_threaded ){
+    CV_Assert( connectivity_type == CONNECTIVITY_4 || connectivity_type == CONNECTIVITY_8 );
 }
 
 ConnectedComponent::~ConnectedComponent(){
@@ -23,142 +27,311 @@ ConnectedComponent::~ConnectedComponent(){
 
 /**
  * Apply connected component labeling
- * it only works for predefined maximum no of connected components
- * and currently treat black color as background
+ * it currently treat black color as background
  */
 Mat ConnectedComponent::apply( const Mat& image ) {
     CV_Assert( !image.empty() );
     CV_Assert( image.channels() == 1 );
     
-    /* Padding the image with 1 pixel border, just to remove boundary checks */
-    Mat result( image.rows + 2, image.cols + 2, image.type(), Scalar(0) );
-    image.copyTo( Mat( result, Rect(1, 1, image.cols, image.rows) ) );
-    result.convertTo( result, CV_32SC1 );
+    if( multiThreaded )
+        return applyMultiThreaded( image );
     
-    /* First pass: labeling the regions incrementally */
-    nextLabel = 1;
-    vector<int> linked(maxComponent);
+    /* Label with the allocation free two pass scan, single isolated pixels are left as background, */
+    /* and the labels follow the raster order of each component's first pixel, same as applyMultiThreaded() */
+    Mat binary = image.type() == CV_8UC1 ? image : Mat( image != 0 );
+    Mat result;
     
-    
-    /* Function pointer, it makes everything hard to read... */
-    /* Basically use function pointer to decide whether to use 4 or 8 neighbors connectivity */
-    std::function<vector<int> (int*, int*, int)> func_ptr;
+    int no_of_labels;
     if( connectivityType == 8 )
-        func_ptr = std::bind(&ConnectedComponent::get8Neighbors, this, placeholders::_1, placeholders::_2, placeholders::_3);
+        no_of_labels = TwoPassLabeling<8>::apply( binary, result, true );
     else
-        func_ptr = std::bind(&ConnectedComponent::get4Neighbors, this, placeholders::_1, placeholders::_2, placeholders::_3);
+        no_of_labels = TwoPassLabeling<4>::apply( binary, result, true );
     
+    computeProperties( result, no_of_labels );
     
-    /* Preparing the pointers */
-    int * prev_ptr = result.ptr<int>(0);
-    int * curr_ptr = result.ptr<int>(1);
+    return result;
+}
+
+/**
+ * Multi-threaded version of apply(), the image is labeled in horizontal strips in parallel,
+ * and the result is the same as the serial version
+ */
+Mat ConnectedComponent::applyMultiThreaded( const Mat& image ) {
+    /* Padding the binary mask with 1 pixel border, so that each strip doesn't need boundary checks */
+    Mat mask( image.rows + 2, image.cols + 2, CV_8UC1, Scalar(0) );
+    Mat( image != 0 ).copyTo( Mat( mask, Rect(1, 1, image.cols, image.rows) ) );
     
-    for( int y = 1; y < result.rows - 1; y++ ) {
-        int * next_ptr = result.ptr<int>(y + 1);
-        
-        for( int x = 1; x < result.cols - 1; x++ ) {
+    /* A few strips per thread, so that the load is still balanced when some strips are denser than others */
+    Mat result;
+    StripLabeling labeling( connectivityType, getNumThreads() * 4 );
+    int no_of_labels = labeling.apply( mask, result );
+    
+    /* Remove our padding borders */
+    result = Mat( result, Rect(1, 1, image.cols, image.rows) );
+    
+    computeProperties( result, no_of_labels );
+    
+    return result;
+}
+
+/**
+ * Running sums of the raw moments and the extent of a blob
+ */
+struct BlobStatistics {
+    int64 m00, m10, m01, m20, m11, m02;
+    int minX, minY, maxX, maxY;
+    
+    BlobStatistics()
+    : m00(0), m10(0), m01(0), m20(0), m11(0), m02(0),
+      minX(INT_MAX), minY(INT_MAX), maxX(-1), maxY(-1) {
+    }
+};
+
+/**
+ * Find the solidity of each blob from blob area / convex area,
+ * each blob only looks at the label image within its own bounding box
+ */
+class SolidityCalculator : public ParallelLoopBody {
+public:
+    SolidityCalculator( const Mat& labels, vector<ComponentProperty>& properties )
+    : labels( labels ), properties( properties ) {
+    }
+    
+    void operator()( const Range& range ) const {
+        for( int i = range.start; i < range.end; i++ ) {
+            ComponentProperty& prop = properties[i];
+            const Rect& box         = prop.boundingBox;
+            
+            /* findContours ignores the 1 pixel border of the image, so pad the bounding box */
+            Mat blob( box.height + 2, box.width + 2, CV_8UC1, Scalar(0) );
+            Mat inside = Mat( labels, box ) == prop.labelID;
+            inside.copyTo( Mat( blob, Rect(1, 1, box.width, box.height) ) );
             
-            if( curr_ptr[x] != 0 ) {
-                vector<int> neighbors = func_ptr( curr_ptr, prev_ptr, x );
+            vector<vector<Point>> contours;
+            findContours( blob, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE );
+            
+            if( !contours.empty() ) {
+                vector<Point> hull;
+                convexHull( contours[0], hull );
                 
-                if( neighbors.empty() ) {
-                    if( connectivityType == 8 && curr_ptr[x+1] == 0 && next_ptr[x] == 0 && next_ptr[x-1] == 0 && next_ptr[x+1] == 0 ) {
-                        /* If it's single isolated pixel, why even bother */
-                        curr_ptr[x] = 0;
-                    }
-                    else if( connectivityType == 4 && curr_ptr[x+1] == 0 && next_ptr[x] == 0 ) {
-                        /* If it's single isolated pixel, why even bother */
-                        curr_ptr[x] = 0;
-                    }
-                    else {
-                        /* If it's new unconnected blob */
-                        curr_ptr[x] = nextLabel;
-                        nextLabel++;
-                        
-                        if( nextLabel >= maxComponent ) {
-                            stringstream ss;
-                            ss  << "Current label count [" << (int) nextLabel
-                            << "] exceeds maximum no of components [" << maxComponent << "]";
-                            throw std::runtime_error( ss.str() );
-                        }
-                    }
-                }
-                else {
-                    /* Use the minimum label out from the neighbors */
-                    int min_index = (int) (min_element( neighbors.begin(), neighbors.end() ) - neighbors.begin());
-                    curr_ptr[x]   = neighbors[min_index];
-                    
-                    for( int neighbor: neighbors )
-                        disjointUnion( curr_ptr[x], neighbor, linked );
-                }
+                /* ... I hope this is correct ... */
+                prop.solidity = prop.area / contourArea( hull );
             }
         }
+    }
+    
+private:
+    const Mat& labels;
+    vector<ComponentProperty>& properties;
+};
+
+/**
+ * Gather the properties of each blob from the label image, where the labels are consecutive from 1 to no_of_labels.
+ * Area, moments, centroid and bounding box are accumulated in a single pass over the label image,
+ * then the solidity is computed in parallel across the blobs
+ */
+void ConnectedComponent::computeProperties( const Mat& labels, int no_of_labels ) {
+    vector<BlobStatistics> stats( no_of_labels );
+    
+    for( int y = 0; y < labels.rows; y++ ) {
+        const int * label_ptr = labels.ptr<int>(y);
         
-        /* Shift the pointers */
-        prev_ptr = curr_ptr;
-        curr_ptr = next_ptr;
+        for( int x = 0; x < labels.cols; x++ ) {
+            if( label_ptr[x] == 0 )
+                continue;
+            
+            BlobStatistics& stat = stats[label_ptr[x] - 1];
+            stat.m00++;
+            stat.m10 += x;
+            stat.m01 += y;
+            stat.m20 += (int64) x * x;
+            stat.m11 += (int64) x * y;
+            stat.m02 += (int64) y * y;
+            
+            stat.minX = MIN( stat.minX, x );
+            stat.maxX = MAX( stat.maxX, x );
+            stat.minY = MIN( stat.minY, y );
+            stat.maxY = MAX( stat.maxY, y );
+        }
     }
     
+    setProperties( stats );
     
-    /* Remove our padding borders */
-    result = Mat( result, Rect(1, 1, image.cols, image.rows) );
+    parallel_for_( Range( 0, no_of_labels ), SolidityCalculator( labels, properties ) );
+    
+    /* By default, sort the properties from the area size in descending order */
+    sort( properties.begin(), properties.end(), [=](ComponentProperty& a, ComponentProperty& b){
+        return a.area > b.area;
+    });
+}
+
+/**
+ * Label the image using run length encoding, each row is first converted into runs of foreground pixels,
+ * and then the runs are labeled instead of the pixels. Returns the runs of each component, where the
+ * component at index i has the label i + 1, and the labels follow the same order as apply().
+ * Isolated single pixels are ignored, just like apply()
+ */
+vector<vector<PixelRun>> ConnectedComponent::applyRunLength( const Mat& image ) {
+    CV_Assert( !image.empty() );
+    CV_Assert( image.channels() == 1 );
+    
+    Mat binary = image;
+    if( image.type() != CV_8UC1 )
+        binary = image != 0;
     
-    /* Second pass: merge the equivalent labels */
-    nextLabel = 1;
-    vector<int> temp, labels_set(maxComponent);
-    for( int y = 0; y < result.rows; y++ ) {
-        int * curr_ptr = result.ptr<int>(y);
+    /* Convert each row into runs, row_start[y] is the index of the first run of row y */
+    vector<PixelRun> runs;
+    vector<int> row_start( binary.rows + 1 );
+    for( int y = 0; y < binary.rows; y++ ) {
+        const uchar * ptr = binary.ptr<uchar>(y);
+        row_start[y] = static_cast<int>( runs.size() );
         
-        for( int x = 0; x < result.cols; x++ ) {
-            if( curr_ptr[x] != 0 ) {
-                curr_ptr[x] = disjointFind( curr_ptr[x], linked, labels_set );
-                temp.push_back( curr_ptr[x] );
-            }
+        int x = 0;
+        while( x < binary.cols ) {
+            while( x < binary.cols && ptr[x] == 0 )
+                x++;
+            if( x == binary.cols )
+                break;
+            
+            int start = x;
+            while( x < binary.cols && ptr[x] != 0 )
+                x++;
+            runs.push_back( PixelRun( y, start, x ) );
         }
     }
+    row_start[binary.rows] = static_cast<int>( runs.size() );
     
-    
-    /* Get the unique labels */
-    vector<int> labels;
-    if( !temp.empty() ) {
-        std::sort( temp.begin(), temp.end() );
-        std::unique_copy( temp.begin(), temp.end(), std::back_inserter( labels ) );
+    const int no_of_runs = static_cast<int>( runs.size() );
+    if( no_of_runs == 0 ) {
+        properties.clear();
+        return vector<vector<PixelRun>>();
     }
     
-    /* Gather the properties of each blob */
-    properties.resize( labels.size() );
-    for( int i = 0; i < labels.size(); i++ ) {
-        Mat blob        = result == labels[i];
-        
-        Moments moment  = cv::moments( blob );
-        
-        properties[i].labelID   = labels[i];
-        properties[i].area      = countNonZero( blob );
-        
-        properties[i].eccentricity = calculateBlobEccentricity( moment );
-        properties[i].centroid     = calculateBlobCentroid( moment );
+    /* Each run starts as its own set, runs that touch the runs of the row above are merged */
+    /* with 8 neighbors, runs that only touch diagonally are connected too */
+    vector<int> parent( no_of_runs );
+    for( int i = 0; i < no_of_runs; i++ )
+        parent[i] = i;
+    
+    const int reach = connectivityType == 8 ? 1 : 0;
+    for( int y = 1; y < binary.rows; y++ ) {
+        int above           = row_start[y - 1];
+        const int above_end = row_start[y];
         
-        /* Find the solidity of the blob from blob area / convex area */
-        vector<vector<Point>> contours;
-        findContours( blob, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE );
+        for( int i = row_start[y]; i < row_start[y + 1]; i++ ) {
+            const PixelRun& run = runs[i];
+            
+            /* Skip the runs above that end before this run starts, they can't touch the following runs either */
+            while( above < above_end && runs[above].end + reach <= run.start )
+                above++;
+            
+            /* The last touching run might also touch the next run, so don't advance past it */
+            for( int j = above; j < above_end && runs[j].start < run.end + reach; j++ )
+                mergeLabels( &parent[0], i, j );
+        }
+    }
+    
+    /* Flatten, so that each run points directly to its root, the first run of its component in raster order */
+    vector<int> areas( no_of_runs, 0 ), run_counts( no_of_runs, 0 );
+    for( int i = 0; i < no_of_runs; i++ ) {
+        parent[i] = parent[parent[i]];
+        areas[parent[i]]      += runs[i].end - runs[i].start;
+        run_counts[parent[i]] += 1;
+    }
+    
+    /* Components are numbered in the order of their roots, skipping isolated pixels */
+    vector<int> component_index( no_of_runs, -1 );
+    vector<vector<PixelRun>> components;
+    for( int i = 0; i < no_of_runs; i++ ) {
+        if( parent[i] == i && areas[i] > 1 ) {
+            component_index[i] = static_cast<int>( components.size() );
+            components.push_back( vector<PixelRun>() );
+            components.back().reserve( run_counts[i] );
+        }
+    }
+    
+    for( int i = 0; i < no_of_runs; i++ ) {
+        int index = component_index[parent[i]];
+        if( index >= 0 )
+            components[index].push_back( runs[i] );
+    }
+    
+    computeRunProperties( components );
+    
+    return components;
+}
+
+/**
+ * Gather the properties of each component directly from its runs, the sums of x and x^2 over a run
+ * have closed forms, and the convex hull of a component only depends on the end points of its runs
+ */
+void ConnectedComponent::computeRunProperties( const vector<vector<PixelRun>>& components ) {
+    const int no_of_components = static_cast<int>( components.size() );
+    vector<BlobStatistics> stats( no_of_components );
+    
+    for( int i = 0; i < no_of_components; i++ ) {
+        BlobStatistics& stat = stats[i];
         
-        if( !contours.empty() ) {
-            vector<vector<Point>> hull(1);
-            convexHull( contours[0], hull[0] );
+        for( const PixelRun& run: components[i] ) {
+            const int64 n       = run.end - run.start;
+            const int64 first   = run.start;
+            const int64 last    = run.end - 1;
+            const int64 sum_x   = (first + last) * n / 2;
+            const int64 sum_xx  = (last * (last + 1) * (2 * last + 1) - (first - 1) * first * (2 * first - 1)) / 6;
+            
+            stat.m00 += n;
+            stat.m10 += sum_x;
+            stat.m01 += run.y * n;
+            stat.m20 += sum_xx;
+            stat.m11 += run.y * sum_x;
+            stat.m02 += (int64) run.y * run.y * n;
             
-            /* ... I hope this is correct ... */
-            properties[i].solidity = properties[i].area / contourArea( hull[0] );
+            stat.minX = MIN( stat.minX, run.start );
+            stat.maxX = MAX( stat.maxX, run.end - 1 );
+            stat.minY = MIN( stat.minY, run.y );
+            stat.maxY = MAX( stat.maxY, run.y );
         }
     }
     
+    setProperties( stats );
+    
+    /* Find the solidity of the blob from blob area / convex area */
+    for( int i = 0; i < no_of_components; i++ ) {
+        vector<Point> points, hull;
+        points.reserve( components[i].size() * 2 );
+        for( const PixelRun& run: components[i] ) {
+            points.push_back( Point( run.start, run.y ) );
+            points.push_back( Point( run.end - 1, run.y ) );
+        }
+        
+        convexHull( points, hull );
+        properties[i].solidity = properties[i].area / contourArea( hull );
+    }
     
     /* By default, sort the properties from the area size in descending order */
     sort( properties.begin(), properties.end(), [=](ComponentProperty& a, ComponentProperty& b){
         return a.area > b.area;
     });
-    
-    
-    return result;
+}
+
+/**
+ * Convert the accumulated statistics into component properties, stats[i] belongs to the label i + 1.
+ * Solidity is left to the caller
+ */
+void ConnectedComponent::setProperties( const vector<BlobStatistics>& stats ) {
+    properties.resize( stats.size() );
+    for( size_t i = 0; i < stats.size(); i++ ) {
+        const BlobStatistics& stat = stats[i];
+        Moments moment( (double) stat.m00, (double) stat.m10, (double) stat.m01,
+                        (double) stat.m20, (double) stat.m11, (double) stat.m02, 0.0, 0.0, 0.0, 0.0 );
+        
+        properties[i].labelID       = static_cast<int>( i ) + 1;
+        properties[i].area          = static_cast<int>( stat.m00 );
+        properties[i].boundingBox   = Rect( stat.minX, stat.minY, stat.maxX - stat.minX + 1, stat.maxY - stat.minY + 1 );
+        properties[i].eccentricity  = calculateBlobEccentricity( moment );
+        properties[i].centroid      = calculateBlobCentroid( moment );
+        properties[i].solidity      = 0.0f;
+    }
 }
 
 /**
@@ -21,11 +21,13 @@ struct ComponentProperty {
     float eccentricity;
     float solidity;
     cv::Point2f centroid;
+    cv::Rect boundingBox;
 
     friend std::ostream &operator <<( std::ostream& os, const ComponentProperty & prop ) {
         os << "     Label ID: " << prop.labelID      << "\n";
         os << "         Area: " << prop.area         << "\n";
         os << "     Centroid: " << prop.centroid     << "\n";
+        os << " Bounding box: " << prop.boundingBox  << "\n";
         os << " Eccentricity: " << prop.eccentricity << "\n";
         os << "     Solidity: " << prop.solidity     << "\n";
         return os;
@@ -33,6 +35,30 @@ struct ComponentProperty {
 };
 
 
+/**
+ * A horizontal run of foreground pixels, covering the columns [start, end) of row y
+ */
+struct PixelRun {
+    int y;
+    int start;
+    int end;
+    
+    PixelRun( int y, int start, int end ) : y( y ), start( start ), end( end ) {}
+};
+
+struct BlobStatistics;
+
+/**
+ * Which neighbors of a pixel belong to the same component. It's an enum rather than an int, so that the old
+ * ConnectedComponent( max_component, connectivity_type ) calls fail to compile, instead of silently being read
+ * as a connectivity
+ */
+enum Connectivity {
+    CONNECTIVITY_4 = 4,
+    CONNECTIVITY_8 = 8,
+};
+
+
 /**
  * Connected component labeling using 8-connected neighbors, based on
  * http://en.wikipedia.org/wiki/Connected-component_labeling
@@ -42,10 +68,11 @@ struct ComponentProperty {
  */
 class ConnectedComponent {
 public:
-    ConnectedComponent( int max_component = 1000, int connectivity_type = 8 );
+    explicit ConnectedComponent( Connectivity connectivity_type = CONNECTIVITY_8, bool multi_threaded = false );
     virtual ~ConnectedComponent();
     
     cv::Mat apply( const cv::Mat& image );
+    std::vector<std::vector<PixelRun>> applyRunLength( const cv::Mat& image );
     
     int getComponentsCount();
     const std::vector<ComponentProperty>& getComponentsProperties();
@@ -54,6 +81,10 @@ public:
     std::vector<int> get4Neighbors( int * curr_ptr, int * prev_ptr, int x );
     
 protected:
+    cv::Mat applyMultiThreaded( const cv::Mat& image );
+    void computeProperties( const cv::Mat& labels, int no_of_labels );
+    void computeRunProperties( const std::vector<std::vector<PixelRun>>& components );
+    void setProperties( const std::vector<BlobStatistics>& stats );
     float calculateBlobEccentricity( const cv::Moments& moment );
     cv::Point2f calculateBlobCentroid( const cv::Moments& moment );
     
@@ -62,7 +93,7 @@ protected:
     
 private:
     int connectivityType;
-    int maxComponent;
+    bool multiThreaded;
     int nextLabel;
     std::vector<ComponentProperty> properties;
 };
@@ -0,0 +1,219 @@
+//
+//  StripLabeling.cpp
+//  ConnectedComponent
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#include "StripLabeling.h"
+#include "UnionFind.h"
+
+using namespace std;
+using namespace cv;
+
+StripLabeling::StripLabeling( int connectivity_type, int no_of_strips )
+: connectivityType( connectivity_type ),
+  noOfStrips( no_of_strips ) {
+}
+
+/**
+ * Label the given padded binary mask (with 1 pixel of zero border all around),
+ * the padded label image is written to labels. Returns the number of components found
+ */
+int StripLabeling::apply( const Mat& padded_mask, Mat& padded_labels ) {
+    CV_Assert( padded_mask.type() == CV_8UC1 );
+
+    mask = padded_mask;
+    padded_labels.create( mask.size(), CV_32SC1 );
+    padded_labels = Scalar(0);
+    labels = padded_labels;
+
+    /* Split the rows inside the padding evenly into strips */
+    const int rows = mask.rows - 2;
+    const int no_of_strips = MAX( 1, MIN( noOfStrips, rows ) );
+
+    stripStart.resize( no_of_strips + 1 );
+    for( int i = 0; i <= no_of_strips; i++ )
+        stripStart[i] = 1 + (rows * i) / no_of_strips;
+
+    stripParents.resize( no_of_strips );
+
+    /* First pass: every strip is labeled independently */
+    phase = LABEL_STRIPS;
+    parallel_for_( Range(0, no_of_strips), *this );
+
+    /* Each strip gets its own range of labels in the global equivalence table */
+    offsets.resize( no_of_strips + 1 );
+    offsets[0] = 0;
+    for( int i = 0; i < no_of_strips; i++ )
+        offsets[i + 1] = offsets[i] + static_cast<int>( stripParents[i].size() ) - 1;
+
+    const int total = offsets[no_of_strips];
+    equivalences = vector<atomic<int>>( total + 1 );
+    equivalences[0] = 0;
+
+    phase = COLLECT_EQUIVALENCES;
+    parallel_for_( Range(0, no_of_strips), *this );
+
+    /* Merge the labels that meet across each boundary between two strips */
+    phase = MERGE_BOUNDARIES;
+    parallel_for_( Range(1, no_of_strips), *this );
+
+    /* Flatten the equivalences, every label points to a smaller one, so its root's final label is already known */
+    finalLabels.assign( total + 1, 0 );
+    int count = 0;
+    for( int i = 1; i <= total; i++ ) {
+        int parent     = equivalences[i].load();
+        finalLabels[i] = parent < i ? finalLabels[parent] : ++count;
+    }
+
+    /* Second pass: write the final labels back */
+    phase = RELABEL_STRIPS;
+    parallel_for_( Range(0, no_of_strips), *this );
+
+    return count;
+}
+
+void StripLabeling::operator()( const Range& range ) const {
+    for( int strip = range.start; strip < range.end; strip++ ) {
+        switch( phase ) {
+            case LABEL_STRIPS:          labelStrip( strip ); break;
+            case COLLECT_EQUIVALENCES:  collectEquivalences( strip ); break;
+            case MERGE_BOUNDARIES:      mergeBoundary( strip ); break;
+            case RELABEL_STRIPS:        relabelStrip( strip ); break;
+        }
+    }
+}
+
+/**
+ * Check whether the pixel has no foreground neighbor at all, in which case it's ignored just like in apply()
+ */
+inline bool StripLabeling::isIsolated( const uchar * prev_mask, const uchar * curr_mask, const uchar * next_mask, int x ) const {
+    if( prev_mask[x] || curr_mask[x-1] || curr_mask[x+1] || next_mask[x] )
+        return false;
+
+    if( connectivityType == 8 )
+        return !( prev_mask[x-1] || prev_mask[x+1] || next_mask[x-1] || next_mask[x+1] );
+
+    return true;
+}
+
+/**
+ * Label a single strip with local labels starting from 1. The first row of the strip doesn't look at the strip above it,
+ * instead it uses the padded top row, which is always zero
+ */
+void StripLabeling::labelStrip( int strip ) const {
+    const int y0    = stripStart[strip];
+    const int y1    = stripStart[strip + 1];
+    const int cols  = mask.cols - 2;
+
+    vector<int>& parent = stripParents[strip];
+    parent.clear();
+    parent.reserve( provisionalLabelBound( y1 - y0, cols, connectivityType ) );
+    parent.push_back( 0 );
+    int * par = &parent[0];
+
+    for( int y = y0; y < y1; y++ ) {
+        const uchar * prev_mask = mask.ptr<uchar>(y - 1);
+        const uchar * curr_mask = mask.ptr<uchar>(y);
+        const uchar * next_mask = mask.ptr<uchar>(y + 1);
+
+        const int * prev_ptr = y == y0 ? labels.ptr<int>(0) : labels.ptr<int>(y - 1);
+        int * curr_ptr       = labels.ptr<int>(y);
+
+        for( int x = 1; x <= cols; x++ ) {
+            if( !curr_mask[x] )
+                continue;
+
+            int label = 0;
+            if( connectivityType == 8 ) {
+                const int neighbors[4] = { prev_ptr[x-1], prev_ptr[x], prev_ptr[x+1], curr_ptr[x-1] };
+                for( int neighbor: neighbors ) {
+                    if( neighbor != 0 )
+                        label = label == 0 ? neighbor : mergeLabels( par, label, neighbor );
+                }
+            }
+            else {
+                const int neighbors[2] = { prev_ptr[x], curr_ptr[x-1] };
+                for( int neighbor: neighbors ) {
+                    if( neighbor != 0 )
+                        label = label == 0 ? neighbor : mergeLabels( par, label, neighbor );
+                }
+            }
+
+            if( label == 0 ) {
+                if( isIsolated( prev_mask, curr_mask, next_mask, x ) )
+                    continue;
+
+                /* If it's new unconnected blob */
+                label = static_cast<int>( parent.size() );
+                parent.push_back( label );
+            }
+
+            curr_ptr[x] = label;
+        }
+    }
+}
+
+/**
+ * Copy the local equivalences of the strip into its range of the global equivalence table
+ */
+void StripLabeling::collectEquivalences( int strip ) const {
+    const vector<int>& parent = stripParents[strip];
+    const int offset          = offsets[strip];
+
+    for( int i = 1; i < static_cast<int>( parent.size() ); i++ )
+        equivalences[offset + i] = offset + findRoot( &parent[0], i );
+}
+
+/**
+ * Merge the labels of the first row of the strip with the labels of the last row of the strip above it
+ */
+void StripLabeling::mergeBoundary( int strip ) const {
+    const int y             = stripStart[strip];
+    const int cols          = mask.cols - 2;
+    const int prev_offset   = offsets[strip - 1];
+    const int curr_offset   = offsets[strip];
+
+    const int * prev_ptr = labels.ptr<int>(y - 1);
+    const int * curr_ptr = labels.ptr<int>(y);
+    atomic<int> * equiv  = &equivalences[0];
+
+    for( int x = 1; x <= cols; x++ ) {
+        if( curr_ptr[x] == 0 )
+            continue;
+
+        const int label = curr_offset + curr_ptr[x];
+
+        if( prev_ptr[x] != 0 )
+            mergeLabels( equiv, label, prev_offset + prev_ptr[x] );
+
+        if( connectivityType == 8 ) {
+            if( prev_ptr[x-1] != 0 )
+                mergeLabels( equiv, label, prev_offset + prev_ptr[x-1] );
+            if( prev_ptr[x+1] != 0 )
+                mergeLabels( equiv, label, prev_offset + prev_ptr[x+1] );
+        }
+    }
+}
+
+/**
+ * Replace the local labels of the strip with their final labels
+ */
+void StripLabeling::relabelStrip( int strip ) const {
+    const int y0     = stripStart[strip];
+    const int y1     = stripStart[strip + 1];
+    const int cols   = mask.cols - 2;
+    const int offset = offsets[strip];
+    const int * final_labels = &finalLabels[0];
+
+    for( int y = y0; y < y1; y++ ) {
+        int * curr_ptr = labels.ptr<int>(y);
+
+        for( int x = 1; x <= cols; x++ ) {
+            if( curr_ptr[x] != 0 )
+                curr_ptr[x] = final_labels[offset + curr_ptr[x]];
+        }
+    }
+}
@@ -0,0 +1,65 @@
+//
+//  StripLabeling.h
+//  ConnectedComponent
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __ConnectedComponent__StripLabeling__
+#define __ConnectedComponent__StripLabeling__
+
+#include <iostream>
+#include <atomic>
+#include <opencv2/opencv.hpp>
+
+/**
+ * Multi-threaded connected component labeling.
+ *
+ * The image is split into horizontal strips, and each strip is labeled independently with its own label range,
+ * using the same padded border and isolated pixel rules as ConnectedComponent::apply().
+ * The equivalences along the strip boundaries are then merged with a lock free union-find,
+ * before the final labels are written back to each strip in parallel.
+ *
+ * Final labels are consecutive starting from 1, in the raster order of each component's first pixel,
+ * so the result is the same as the serial ConnectedComponent::apply()
+ */
+class StripLabeling : public cv::ParallelLoopBody {
+public:
+    StripLabeling( int connectivity_type, int no_of_strips );
+
+    int apply( const cv::Mat& mask, cv::Mat& labels );
+    void operator()( const cv::Range& range ) const;
+
+protected:
+    enum Phase {
+        LABEL_STRIPS,
+        COLLECT_EQUIVALENCES,
+        MERGE_BOUNDARIES,
+        RELABEL_STRIPS,
+    };
+
+    void labelStrip( int strip ) const;
+    void collectEquivalences( int strip ) const;
+    void mergeBoundary( int strip ) const;
+    void relabelStrip( int strip ) const;
+    inline bool isIsolated( const uchar * prev_mask, const uchar * curr_mask, const uchar * next_mask, int x ) const;
+
+private:
+    int connectivityType;
+    int noOfStrips;
+    Phase phase;
+
+    /* Padded binary mask, shared by all the strips */
+    cv::Mat mask;
+    std::vector<int> stripStart;
+    std::vector<int> offsets;
+    std::vector<int> finalLabels;
+
+    /* Each strip only ever writes to its own rows and entries, so these are mutable for the parallel phases */
+    mutable cv::Mat labels;
+    mutable std::vector<std::vector<int>> stripParents;
+    mutable std::vector<std::atomic<int>> equivalences;
+};
+
+#endif /* defined(__ConnectedComponent__StripLabeling__) */
@@ -0,0 +1,325 @@
+//
+//  TwoPassLabeling.cpp
+//  ConnectedComponent
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#include "TwoPassLabeling.h"
+#include "UnionFind.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Label the connected components of the given binary image, returns the number of components found
+ */
+template <int Connectivity>
+int TwoPassLabeling<Connectivity>::apply( const Mat& image, Mat& labels, bool drop_isolated ) {
+    CV_Assert( !image.empty() );
+    CV_Assert( image.type() == CV_8UC1 );
+
+    labels.create( image.size(), CV_32SC1 );
+
+    /* The union find array is reserved once, so that it never reallocates during the scan, */
+    /* and only the labels that are actually used get touched. Background label 0 always points to itself */
+    vector<int> parent;
+    parent.reserve( provisionalLabelBound( image.rows, image.cols, Connectivity ) );
+    parent.push_back( 0 );
+
+    int no_of_labels = firstPass( image, labels, parent, drop_isolated );
+    return secondPass( image, labels, parent, no_of_labels );
+}
+
+/**
+ * Whether the foreground pixel at (x, y) has no foreground 8-neighbors, pixels outside of the image are background
+ */
+template <>
+bool TwoPassLabeling<8>::isIsolated( const Mat& image, int x, int y ) {
+    for( int ny = MAX( y - 1, 0 ); ny <= MIN( y + 1, image.rows - 1 ); ny++ ) {
+        const uchar * ptr = image.ptr<uchar>(ny);
+        for( int nx = MAX( x - 1, 0 ); nx <= MIN( x + 1, image.cols - 1 ); nx++ ) {
+            if( ptr[nx] && (nx != x || ny != y) )
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Whether the foreground pixel at (x, y) has no foreground 4-neighbors, pixels outside of the image are background
+ */
+template <>
+bool TwoPassLabeling<4>::isIsolated( const Mat& image, int x, int y ) {
+    const uchar * ptr = image.ptr<uchar>(y);
+    if( (x > 0 && ptr[x - 1]) || (x + 1 < image.cols && ptr[x + 1]) )
+        return false;
+    if( y > 0 && image.ptr<uchar>(y - 1)[x] )
+        return false;
+    return !(y + 1 < image.rows && image.ptr<uchar>(y + 1)[x]);
+}
+
+/**
+ * First pass for 8 connectivity, scan the image in 2x2 blocks, and store the provisional label
+ * of each block at its top left pixel. Returns the number of provisional labels used
+ *   | a | b | c | d |
+ *   | e | o | p |
+ *   | g | s | t |
+ */
+template <>
+int TwoPassLabeling<8>::firstPass( const Mat& image, Mat& labels, vector<int>& parent, bool drop_isolated ) {
+    const int rows = image.rows;
+    const int cols = image.cols;
+
+    int * par      = &parent[0];
+    int next_label = 1;
+
+    /* Stands in for the rows outside of the image, so that the scan doesn't need boundary checks vertically */
+    vector<uchar> empty_row( cols, 0 );
+
+    for( int y = 0; y < rows; y += 2 ) {
+        const uchar * prev_ptr = y > 0        ? image.ptr<uchar>(y - 1) : &empty_row[0];
+        const uchar * curr_ptr = image.ptr<uchar>(y);
+        const uchar * next_ptr = y + 1 < rows ? image.ptr<uchar>(y + 1) : &empty_row[0];
+
+        const int * prev_labels = y > 0 ? labels.ptr<int>(y - 2) : NULL;
+        int * curr_labels       = labels.ptr<int>(y);
+
+        for( int x = 0; x < cols; x += 2 ) {
+            const bool has_left      = x > 0;
+            const bool has_right     = x + 1 < cols;
+            const bool has_far_right = x + 2 < cols;
+
+            const bool o = curr_ptr[x] != 0;
+            const bool p = has_right && curr_ptr[x + 1] != 0;
+            const bool s = next_ptr[x] != 0;
+            const bool t = has_right && next_ptr[x + 1] != 0;
+
+            if( !(o || p || s || t) ) {
+                curr_labels[x] = 0;
+                continue;
+            }
+
+            const bool a = has_left      && prev_ptr[x - 1] != 0;
+            const bool b = prev_ptr[x] != 0;
+            const bool c = has_right     && prev_ptr[x + 1] != 0;
+            const bool d = has_far_right && prev_ptr[x + 2] != 0;
+            const bool e = has_left      && curr_ptr[x - 1] != 0;
+            const bool g = has_left      && next_ptr[x - 1] != 0;
+
+            /* Which of the neighboring blocks are connected to block X */
+            const bool connect_p = a && o;
+            const bool connect_q = (b || c) && (o || p);
+            const bool connect_r = d && p;
+            const bool connect_s = (e || g) && (o || s);
+
+            int label = 0;
+            if( connect_q ) {
+                label = prev_labels[x];
+
+                /* c-d, a-b, and b-e pairs mean that R, P and S are already merged with Q in previous scans */
+                if( connect_r && !c )
+                    label = mergeLabels( par, label, prev_labels[x + 2] );
+                if( connect_p && !b )
+                    label = mergeLabels( par, label, prev_labels[x - 2] );
+                if( connect_s && !(b && e) )
+                    label = mergeLabels( par, label, curr_labels[x - 2] );
+            }
+            else {
+                if( connect_p )
+                    label = prev_labels[x - 2];
+
+                if( connect_s ) {
+                    /* a-e pair means that S is already merged with P */
+                    if( label == 0 )
+                        label = curr_labels[x - 2];
+                    else if( !e )
+                        label = mergeLabels( par, label, curr_labels[x - 2] );
+                }
+
+                if( connect_r )
+                    label = label == 0 ? prev_labels[x + 2] : mergeLabels( par, label, prev_labels[x + 2] );
+            }
+
+            /* If it's a new unconnected block */
+            if( label == 0 ) {
+                /* An unconnected block with a single pixel could be an isolated pixel, none of its neighbors */
+                /* ever look at its label, so it can stay as background without a provisional label */
+                if( drop_isolated && o + p + s + t == 1 && isIsolated( image, (o || s) ? x : x + 1, (o || p) ? y : y + 1 ) ) {
+                    curr_labels[x] = 0;
+                    continue;
+                }
+
+                label = next_label++;
+                parent.push_back( label );
+            }
+
+            curr_labels[x] = label;
+        }
+    }
+
+    return next_label;
+}
+
+/**
+ * Second pass for 8 connectivity, spread the final label of each block to its foreground pixels.
+ * Blocks are scanned two rows at a time, so to keep the final labels in the raster order of the pixels,
+ * they are handed out row by row, the first time a pixel of each component is seen.
+ * Returns the number of components
+ */
+template <>
+int TwoPassLabeling<8>::secondPass( const Mat& image, Mat& labels, vector<int>& parent, int no_of_labels ) {
+    const int rows = image.rows;
+    const int cols = image.cols;
+    int * par      = &parent[0];
+
+    /* Flatten the equivalences, so that each provisional label points directly to its root */
+    for( int i = 1; i < no_of_labels; i++ )
+        par[i] = par[par[i]];
+
+    vector<int> final_labels( no_of_labels, 0 );
+    int count = 0;
+
+    auto final_label = [&]( int root ) {
+        int& label = final_labels[root];
+        if( label == 0 )
+            label = ++count;
+        return label;
+    };
+
+    for( int y = 0; y < rows; y += 2 ) {
+        const uchar * curr_ptr = image.ptr<uchar>(y);
+        int * curr_labels      = labels.ptr<int>(y);
+
+        const bool has_next = y + 1 < rows;
+        int * next_labels   = has_next ? labels.ptr<int>(y + 1) : NULL;
+
+        /* Top row of the blocks. What the bottom row needs is parked in it: the final label if the top row */
+        /* already has it, otherwise the negated root, which only gets its final label once it's reached */
+        for( int x = 0; x < cols; x += 2 ) {
+            const int block_label = curr_labels[x];
+            const bool has_right  = x + 1 < cols;
+
+            /* Either an empty block, or a dropped isolated pixel */
+            if( block_label == 0 ) {
+                curr_labels[x] = 0;
+                if( has_right )
+                    curr_labels[x + 1] = 0;
+                if( has_next )
+                    next_labels[x] = 0;
+                continue;
+            }
+
+            const int root = par[block_label];
+            const bool o   = curr_ptr[x] != 0;
+            const bool p   = has_right && curr_ptr[x + 1] != 0;
+
+            const int label = (o || p) ? final_label( root ) : 0;
+            curr_labels[x] = o ? label : 0;
+            if( has_right )
+                curr_labels[x + 1] = p ? label : 0;
+
+            if( has_next )
+                next_labels[x] = label != 0 ? label : -root;
+        }
+
+        if( !has_next )
+            continue;
+
+        const uchar * next_ptr = image.ptr<uchar>(y + 1);
+        for( int x = 0; x < cols; x += 2 ) {
+            const int parked     = next_labels[x];
+            const bool has_right = x + 1 < cols;
+
+            const int label = parked < 0 ? final_label( -parked ) : parked;
+            next_labels[x] = next_ptr[x] ? label : 0;
+            if( has_right )
+                next_labels[x + 1] = next_ptr[x + 1] ? label : 0;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * First pass for 4 connectivity, a pixel based scan that only looks at the top and left neighbors
+ *   |   | b |
+ *   | e | o |
+ * If the top left pixel is foreground, then both neighbors are already known to be connected
+ */
+template <>
+int TwoPassLabeling<4>::firstPass( const Mat& image, Mat& labels, vector<int>& parent, bool drop_isolated ) {
+    const int rows = image.rows;
+    const int cols = image.cols;
+
+    int * par      = &parent[0];
+    int next_label = 1;
+
+    vector<uchar> empty_row( cols, 0 );
+
+    for( int y = 0; y < rows; y++ ) {
+        const uchar * prev_ptr  = y > 0 ? image.ptr<uchar>(y - 1) : &empty_row[0];
+        const uchar * curr_ptr  = image.ptr<uchar>(y);
+        const int * prev_labels = y > 0 ? labels.ptr<int>(y - 1) : NULL;
+        int * curr_labels       = labels.ptr<int>(y);
+
+        for( int x = 0; x < cols; x++ ) {
+            if( !curr_ptr[x] ) {
+                curr_labels[x] = 0;
+                continue;
+            }
+
+            const bool b = prev_ptr[x] != 0;
+            const bool e = x > 0 && curr_ptr[x - 1] != 0;
+
+            int label;
+            if( b ) {
+                label = prev_labels[x];
+                if( e && !prev_ptr[x - 1] )
+                    label = mergeLabels( par, label, curr_labels[x - 1] );
+            }
+            else if( e ) {
+                label = curr_labels[x - 1];
+            }
+            else if( drop_isolated && isIsolated( image, x, y ) ) {
+                curr_labels[x] = 0;
+                continue;
+            }
+            else {
+                label = next_label++;
+                parent.push_back( label );
+            }
+
+            curr_labels[x] = label;
+        }
+    }
+
+    return next_label;
+}
+
+/**
+ * Second pass for 4 connectivity, replace each provisional label with its final label. The first pixel of each
+ * component always creates its smallest provisional label, so numbering the roots in order already follows the
+ * raster order. Returns the number of components
+ */
+template <>
+int TwoPassLabeling<4>::secondPass( const Mat&, Mat& labels, vector<int>& parent, int no_of_labels ) {
+    /* Flatten the equivalences, so that each provisional label points directly to its final consecutive label */
+    int count = 0;
+    for( int i = 1; i < no_of_labels; i++ )
+        parent[i] = parent[i] < i ? parent[parent[i]] : ++count;
+
+    const int * par = &parent[0];
+
+    for( int y = 0; y < labels.rows; y++ ) {
+        int * curr_labels = labels.ptr<int>(y);
+        for( int x = 0; x < labels.cols; x++ )
+            curr_labels[x] = par[curr_labels[x]];
+    }
+
+    return count;
+}
+
+template class TwoPassLabeling<4>;
+template class TwoPassLabeling<8>;
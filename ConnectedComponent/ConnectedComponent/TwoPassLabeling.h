@@ -0,0 +1,49 @@
+//
+//  TwoPassLabeling.h
+//  ConnectedComponent
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __ConnectedComponent__TwoPassLabeling__
+#define __ConnectedComponent__TwoPassLabeling__
+
+#include <iostream>
+#include <opencv2/opencv.hpp>
+
+/**
+ * Two pass connected component labeling without any per pixel allocation.
+ *
+ * For 8 connectivity the first pass scans the image in 2x2 blocks, since every foreground pixel
+ * inside a block is 8-connected to each other, only one provisional label per block is needed,
+ * and only the neighboring blocks P, Q, R, S have to be checked:
+ *   | P | Q | R |
+ *   | S | X |
+ * The order of the checks follows the decision tree idea from
+ * "Optimized Block-based Connected Components Labeling with Decision Trees", Grana et al.
+ * so that merges between blocks that are already known to be connected are skipped.
+ *
+ * Pixels inside a 2x2 block are not necessarily 4-connected, so for 4 connectivity the scan
+ * falls back to a pixel based decision tree on the top and left neighbors.
+ *
+ * Equivalences are kept in a flat union-find array, where each entry points to a label that's equal
+ * or smaller than itself, as described in "Optimizing two-pass connected-component labeling algorithms"
+ * by Wu, Otoo and Suzuki.
+ *
+ * Non zero pixels are treated as foreground. Every component is labeled, single isolated pixels included,
+ * unless drop_isolated is set, then they are left as background the same way ConnectedComponent::apply() does.
+ * Output labels are consecutive starting from 1, in the raster order of the first pixel of each component
+ */
+template <int Connectivity>
+class TwoPassLabeling {
+public:
+    static int apply( const cv::Mat& image, cv::Mat& labels, bool drop_isolated = false );
+
+protected:
+    static bool isIsolated( const cv::Mat& image, int x, int y );
+    static int firstPass( const cv::Mat& image, cv::Mat& labels, std::vector<int>& parent, bool drop_isolated );
+    static int secondPass( const cv::Mat& image, cv::Mat& labels, std::vector<int>& parent, int no_of_labels );
+};
+
+#endif /* defined(__ConnectedComponent__TwoPassLabeling__) */
@@ -0,0 +1,98 @@
+//
+//  UnionFind.h
+//  ConnectedComponent
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __ConnectedComponent__UnionFind__
+#define __ConnectedComponent__UnionFind__
+
+#include <atomic>
+#include <algorithm>
+
+/**
+ * Flat union-find on a plain label array, where each entry points to a label that's equal or smaller than
+ * itself, so the root of each set is always its smallest label. Based on
+ * "Optimizing two-pass connected-component labeling algorithms" by Wu, Otoo and Suzuki
+ */
+
+/**
+ * Upper bound of provisional labels that a raster scan could create, plus the background label.
+ * Pixels that get new labels are never adjacent to each other, so for 8 connectivity there's at most
+ * one per 2x2 block, and for 4 connectivity the worst case is a checkerboard pattern
+ */
+inline int provisionalLabelBound( int rows, int cols, int connectivity_type ) {
+    if( connectivity_type == 8 )
+        return ((rows + 1) / 2) * ((cols + 1) / 2) + 1;
+    return (rows * cols + 1) / 2 + 1;
+}
+
+/**
+ * Find the root of the given label, the root is the only label that points to itself
+ */
+inline int findRoot( const int * parent, int i ) {
+    while( parent[i] < i )
+        i = parent[i];
+    return i;
+}
+
+/**
+ * Make every label along the path from i to its root point directly to the given root
+ */
+inline void setRoot( int * parent, int i, int root ) {
+    while( parent[i] < i ) {
+        int j     = parent[i];
+        parent[i] = root;
+        i         = j;
+    }
+    parent[i] = root;
+}
+
+/**
+ * Merge the sets of both labels, the smaller root becomes the root of the merged set, which is then returned
+ */
+inline int mergeLabels( int * parent, int i, int j ) {
+    int root = findRoot( parent, i );
+    if( i != j ) {
+        int root_j = findRoot( parent, j );
+        if( root > root_j )
+            root = root_j;
+        setRoot( parent, j, root );
+    }
+    setRoot( parent, i, root );
+    return root;
+}
+
+/**
+ * Lock free version of findRoot, for when several threads are merging sets in the same array
+ */
+inline int findRoot( const std::atomic<int> * parent, int i ) {
+    int j;
+    while( (j = parent[i].load()) < i )
+        i = j;
+    return i;
+}
+
+/**
+ * Lock free version of mergeLabels, the larger root is linked under the smaller one with compare-and-swap,
+ * and if another thread has linked that root in the meantime, simply retry from the new roots
+ */
+inline void mergeLabels( std::atomic<int> * parent, int i, int j ) {
+    while( true ) {
+        i = findRoot( parent, i );
+        j = findRoot( parent, j );
+        if( i == j )
+            return;
+
+        if( i < j )
+            std::swap( i, j );
+
+        int expected = i;
+        if( parent[i].compare_exchange_weak( expected, j ) )
+            return;
+    }
+}
+
+#endif /* defined(__ConnectedComponent__UnionFind__) */
@@ -9,6 +9,7 @@
 #include <iostream>
 #include <opencv2/opencv.hpp>
 #include "ConnectedComponent.h"
+#include "TwoPassLabeling.h"
 
 using namespace std;
 using namespace cv;
@@ -105,10 +106,66 @@ void test2() {
     while( waitKey(10) != 'q' );
 }
 
+/* Compare the throughput of the labeling implementations. Rows are grouped so that each group times the same work: */
+/* the labeling alone, then the labeling together with the component properties. Isolated pixels are dropped */
+/* everywhere, so the 8 connectivity counts of every row agree */
+void test3() {
+    Mat image = imread( "/Users/saburookita/Sandbox/ConnectedComponent/Example 1.png", CV_LOAD_IMAGE_GRAYSCALE );
+    
+    Mat binary;
+    threshold( image, binary, 200.0, 1.0, CV_THRESH_BINARY_INV );
+    
+    const int runs = 100;
+    const double mega_pixels = binary.total() * runs / 1e6;
+    
+    Mat labels;
+    int count = 0;
+    
+    cout << "Labeling only" << endl;
+    
+    int64 start = getTickCount();
+    for( int i = 0; i < runs; i++ )
+        count = TwoPassLabeling<8>::apply( binary, labels, true );
+    double elapsed = (getTickCount() - start) / getTickFrequency();
+    cout << "TwoPassLabeling<8>    : " << count << " components, " << mega_pixels / elapsed << " MP/s" << endl;
+    
+    start = getTickCount();
+    for( int i = 0; i < runs; i++ )
+        count = TwoPassLabeling<4>::apply( binary, labels, true );
+    elapsed = (getTickCount() - start) / getTickFrequency();
+    cout << "TwoPassLabeling<4>    : " << count << " components, " << mega_pixels / elapsed << " MP/s" << endl;
+    
+    cout << "Labeling and component properties" << endl;
+    
+    ConnectedComponent conn_comp;
+    start = getTickCount();
+    for( int i = 0; i < runs; i++ )
+        labels = conn_comp.apply( binary );
+    elapsed = (getTickCount() - start) / getTickFrequency();
+    cout << "ConnectedComponent    : " << conn_comp.getComponentsCount() << " components, "
+         << mega_pixels / elapsed << " MP/s" << endl;
+    
+    ConnectedComponent multi_threaded( CONNECTIVITY_8, true );
+    start = getTickCount();
+    for( int i = 0; i < runs; i++ )
+        labels = multi_threaded.apply( binary );
+    elapsed = (getTickCount() - start) / getTickFrequency();
+    cout << "ConnectedComponent MT : " << multi_threaded.getComponentsCount() << " components, "
+         << mega_pixels / elapsed << " MP/s" << endl;
+    
+    vector<vector<PixelRun>> components;
+    start = getTickCount();
+    for( int i = 0; i < runs; i++ )
+        components = conn_comp.applyRunLength( binary );
+    elapsed = (getTickCount() - start) / getTickFrequency();
+    cout << "ConnectedComponent RLE: " << components.size() << " components, " << mega_pixels / elapsed << " MP/s" << endl;
+}
+
 int main(int argc, const char * argv[])
 {
     test1();
     test2();
+    test3();
     
     return 0;
 }
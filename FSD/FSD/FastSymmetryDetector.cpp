@@ -8,6 +8,10 @@
 
 #include "FastSymmetryDetector.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define within( val, bottom, top ) ( val > bottom && val < top )
 
 FastSymmetryDetector::FastSymmetryDetector( const Size image_size, const Size hough_size, const int rot_resolution ) {
@@ -36,6 +40,11 @@ FastSymmetryDetector::FastSymmetryDetector( const Size image_size, const Size ho
     accum       = Mat::zeros( thetaMax + 2, rhoMax, CV_32FC1 );
     rotEdges    = Mat::zeros( rhoDivision, diagonal, CV_32FC1 );
     reRows.resize( rhoDivision );
+    
+    /* By default track within 10 deg and 5% of rho around the tracked line */
+    tracking    = false;
+    thetaWindow = MAX( 1, thetaMax / 18 );
+    rhoWindow   = MAX( 1, rhoMax / 20 );
 }
 
 /**
@@ -115,6 +124,446 @@ void FastSymmetryDetector::vote( Mat& image, int min_pair_dist, int max_pair_dis
 }
 
 
+/**
+ * Same as vote(), but the rotated edges of each rho bucket are sorted first, so that the pairs within
+ * the distance band of each edge form a contiguous window that's found with two moving pointers,
+ * instead of walking every pair. The votes are counted in a local integer histogram, which is only
+ * written to the accumulation matrix once per theta.
+ * Unlike vote(), every pair within the distance band gets a vote, not just the ones before the first pair outside it
+ */
+void FastSymmetryDetector::voteSorted( Mat& image, int min_pair_dist, int max_pair_dist ) {
+    float min_dist = min_pair_dist * 0.5;
+    float max_dist = max_pair_dist * 0.5;
+    
+    accum = Scalar::all(0);
+    
+    vector<Point2f> edges;
+    findEdges( image, edges );
+    
+    for( int t = 0; t < thetaMax; t++ )
+        voteTheta( edges, t, min_dist, max_dist, scratch );
+}
+
+/**
+ * Parallel version of voteSorted(), the thetas are distributed among the workers, each with its own scratch buffers.
+ * Each theta only writes to its own row of the accumulation matrix, so the workers never need to synchronize
+ */
+void FastSymmetryDetector::voteParallel( Mat& image, int min_pair_dist, int max_pair_dist ) {
+    float min_dist = min_pair_dist * 0.5;
+    float max_dist = max_pair_dist * 0.5;
+    
+    accum = Scalar::all(0);
+    
+    vector<Point2f> edges;
+    findEdges( image, edges );
+    
+    tbb::parallel_for( 0, thetaMax, 1, [&]( int theta ) {
+        voteTheta( edges, theta, min_dist, max_dist, threadScratch.local() );
+    });
+}
+
+/**
+ * Same as voteParallel(), but a pair of edges only gets a vote if their gradients are mirror images of each other
+ * along the symmetry line. Orientation holds the gradient direction of each pixel in degrees (CV_32FC1), e.g. from
+ * phase( grad_x, grad_y, orientation, true ), and max_angle_diff is how far off from the exact mirror a pair may be.
+ *
+ * The edges are further bucketed by their orientations inside each rho bucket, and only the pairs of buckets
+ * that could possibly be mirrored for the given theta are visited, so most of the pairs are never even looked at
+ */
+void FastSymmetryDetector::voteGradient( Mat& image, Mat& orientation, int min_pair_dist, int max_pair_dist, float max_angle_diff ) {
+    CV_Assert( orientation.type() == CV_32FC1 && orientation.size() == image.size() );
+    
+    float min_dist = min_pair_dist * 0.5;
+    float max_dist = max_pair_dist * 0.5;
+    
+    /* Each orientation bucket has to be at least as wide as max_angle_diff, with half a degree to spare for rounding errors. */
+    /* With less than 4 buckets the neighboring ones would overlap, so just use one bucket for all the orientations */
+    int no_of_bins = MIN( 180, static_cast<int>( 180.0f / (MAX( max_angle_diff, 0.0f ) + 0.5f) ) );
+    if( no_of_bins < 4 )
+        no_of_bins = 1;
+    
+    accum = Scalar::all(0);
+    
+    vector<Point2f> edges;
+    vector<float> orientations;
+    findEdges( image, orientation, edges, orientations );
+    
+    tbb::parallel_for( 0, thetaMax, 1, [&]( int theta ) {
+        voteGradientTheta( edges, orientations, no_of_bins, theta, min_dist, max_dist, max_angle_diff, threadScratch.local() );
+    });
+}
+
+/**
+ * Vote for the symmetry line while tracking it over consecutive frames, as described in the Li & Kleeman paper.
+ * Once a peak with at least min_votes is found, the following frames only vote for the thetas within thetaWindow
+ * of the tracked line, and only look for the new peak within rhoWindow of it. When that peak drops below min_votes,
+ * the line is considered lost, and the full search is done again.
+ * Returns whether there's a line being tracked after this frame
+ */
+bool FastSymmetryDetector::track( Mat& image, int min_pair_dist, int max_pair_dist, float min_votes ) {
+    float min_dist = min_pair_dist * 0.5;
+    float max_dist = max_pair_dist * 0.5;
+    
+    vector<Point2f> edges;
+    findEdges( image, edges );
+    
+    accum = Scalar::all(0);
+    
+    const int no_of_thetas = 2 * thetaWindow + 1;
+    if( tracking && no_of_thetas < thetaMax ) {
+        const int first = trackedPeak.y - thetaWindow + thetaMax;
+        
+        tbb::parallel_for( 0, no_of_thetas, 1, [&]( int i ) {
+            voteTheta( edges, (first + i) % thetaMax, min_dist, max_dist, threadScratch.local() );
+        });
+        
+        if( findTrackedPeak( min_votes ) )
+            return true;
+    }
+    
+    /* Lost, or not tracking anything yet, so search the whole accumulation matrix */
+    tbb::parallel_for( 0, thetaMax, 1, [&]( int theta ) {
+        voteTheta( edges, theta, min_dist, max_dist, threadScratch.local() );
+    });
+    
+    double max_val;
+    Point max_loc;
+    minMaxLoc( accum.rowRange(0, thetaMax), NULL, &max_val, NULL, &max_loc );
+    
+    tracking    = max_val >= min_votes;
+    trackedPeak = max_loc;
+    return tracking;
+}
+
+/**
+ * Look for the highest peak within the windows around the tracked line, and move the tracked line there.
+ * Thetas that wrap around the matrix describe the same lines with their rho mirrored, since rotating by 180 deg
+ * only flips the sign of rho. Returns whether the peak has at least min_votes
+ */
+bool FastSymmetryDetector::findTrackedPeak( float min_votes ) {
+    float max_val = -1.0f;
+    Point max_loc = trackedPeak;
+    
+    for( int i = -thetaWindow; i <= thetaWindow; i++ ) {
+        int theta = trackedPeak.y + i;
+        int rho   = trackedPeak.x;
+        
+        if( theta < 0 || theta >= thetaMax ) {
+            theta = (theta + thetaMax) % thetaMax;
+            rho   = rhoMax - 1 - rho;
+        }
+        
+        const float * accum_ptr = accum.ptr<float>(theta);
+        for( int r = MAX( 0, rho - rhoWindow ); r <= MIN( rhoMax - 1, rho + rhoWindow ); r++ ) {
+            if( accum_ptr[r] > max_val ) {
+                max_val = accum_ptr[r];
+                max_loc = Point( r, theta );
+            }
+        }
+    }
+    
+    tracking    = max_val >= min_votes;
+    trackedPeak = max_loc;
+    return tracking;
+}
+
+/**
+ * Set how far around the tracked line, in theta and rho indices, the following frames are voted for
+ */
+void FastSymmetryDetector::setTrackingWindow( int theta_window, int rho_window ) {
+    thetaWindow = MAX( 0, theta_window );
+    rhoWindow   = MAX( 0, rho_window );
+}
+
+/**
+ * Forget the tracked line, so that the next frame does the full search
+ */
+void FastSymmetryDetector::resetTracking() {
+    tracking = false;
+}
+
+bool FastSymmetryDetector::isTracking() {
+    return tracking;
+}
+
+/**
+ * Return the tracked symmetry line, only valid if isTracking() is true
+ */
+pair<Point, Point> FastSymmetryDetector::getTrackedLine() {
+    return getLine( trackedPeak.x, trackedPeak.y );
+}
+
+/**
+ * Find all the pixels of the edges, translated in relation to center of the image
+ */
+void FastSymmetryDetector::findEdges( Mat& image, vector<Point2f>& edges ) {
+    vector<Point> temp_edges;
+    findNonZero( image, temp_edges );
+    
+    edges.clear();
+    edges.reserve( temp_edges.size() );
+    for( Point point: temp_edges )
+        edges.push_back( Point2f( point.x - center.x, point.y - center.y ) );
+}
+
+/**
+ * Same as above, but also keep the gradient orientation of each edge, modulo 180 degrees
+ */
+void FastSymmetryDetector::findEdges( Mat& image, Mat& orientation, vector<Point2f>& edges, vector<float>& orientations ) {
+    vector<Point> temp_edges;
+    findNonZero( image, temp_edges );
+    
+    edges.clear();
+    edges.reserve( temp_edges.size() );
+    orientations.clear();
+    orientations.reserve( temp_edges.size() );
+    
+    for( Point point: temp_edges ) {
+        edges.push_back( Point2f( point.x - center.x, point.y - center.y ) );
+        
+        float angle = fmodf( orientation.at<float>( point ), 180.0f );
+        if( angle < 0.0f )
+            angle += 180.0f;
+        if( angle >= 180.0f )
+            angle -= 180.0f;
+        orientations.push_back( angle );
+    }
+}
+
+/**
+ * Vote for every pair of the sorted xs that are within the distance band, i.e. min_dist < x1 - x0 < max_dist.
+ * The rho indices of each window are computed 4 at a time, before being counted in the histogram
+ */
+static inline void votePairs( const float * xs, int n, float min_dist, float max_dist, int * histogram, int * indices ) {
+    int lo = 1, hi = 1;
+    
+    for( int i = 0; i < n - 1; i++ ) {
+        const float x0 = xs[i];
+        
+        /* Both ends of the window only ever move forward, since xs is sorted */
+        lo = MAX( lo, i + 1 );
+        while( lo < n && xs[lo] - x0 <= min_dist )
+            lo++;
+        
+        hi = MAX( hi, lo );
+        while( hi < n && xs[hi] - x0 < max_dist )
+            hi++;
+        
+        int j = lo, k = 0;
+#ifdef __SSE2__
+        const __m128 x0_4 = _mm_set1_ps( x0 );
+        for( ; j + 4 <= hi; j += 4, k += 4 ) {
+            __m128i rho_indices = _mm_cvttps_epi32( _mm_add_ps( x0_4, _mm_loadu_ps( xs + j ) ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>( indices + k ), rho_indices );
+        }
+#endif
+        for( ; j < hi; j++, k++ )
+            indices[k] = static_cast<int>( x0 + xs[j] );
+        
+        for( int m = 0; m < k; m++ )
+            histogram[indices[m]]++;
+    }
+}
+
+/**
+ * Rotate the edges to the given theta, sort them into their rho buckets, and vote for the pairs within each bucket
+ */
+void FastSymmetryDetector::voteTheta( const vector<Point2f>& edges, int theta, float min_dist, float max_dist, VotingScratch& scratch ) {
+    const float r0 = rotMatrices[theta].at<float>(0, 0);
+    const float r1 = rotMatrices[theta].at<float>(0, 1);
+    const float r2 = rotMatrices[theta].at<float>(1, 0);
+    const float r3 = rotMatrices[theta].at<float>(1, 1);
+    
+    const float half_diag  = cvRound(diagonal) * 0.5;
+    const float fourth_rho = rhoMax * 0.25;
+    const int no_of_edges  = static_cast<int>( edges.size() );
+    
+    /* Rho is truncated from [0, 2 * half_diag], which could land on rhoDivision itself */
+    const int no_of_buckets = rhoDivision + 1;
+    
+    scratch.rhos.resize( no_of_edges );
+    scratch.xs.resize( no_of_edges );
+    scratch.indices.resize( no_of_edges );
+    scratch.bucketStarts.assign( no_of_buckets + 1, 0 );
+    scratch.histogram.assign( rhoMax, 0 );
+    
+    /* Counting sort the rotated edges by their rho, so that each bucket is contiguous in xs */
+    for( int i = 0; i < no_of_edges; i++ ) {
+        int rho = r2 * edges[i].x + r3 * edges[i].y + half_diag;
+        scratch.rhos[i] = rho;
+        scratch.bucketStarts[rho + 1]++;
+    }
+    
+    for( int i = 0; i < no_of_buckets; i++ )
+        scratch.bucketStarts[i + 1] += scratch.bucketStarts[i];
+    
+    scratch.bucketEnds.assign( scratch.bucketStarts.begin(), scratch.bucketStarts.end() - 1 );
+    for( int i = 0; i < no_of_edges; i++ )
+        scratch.xs[scratch.bucketEnds[scratch.rhos[i]]++] = r0 * edges[i].x + r1 * edges[i].y + fourth_rho;
+    
+    /* Vote within each bucket */
+    for( int i = 0; i < no_of_buckets; i++ ) {
+        float * start = scratch.xs.data() + scratch.bucketStarts[i];
+        float * end   = scratch.xs.data() + scratch.bucketEnds[i];
+        
+        /* Ignore edges that have smaller number of pairings */
+        if( (end - start) <= 1 )
+            continue;
+        
+        sort( start, end );
+        votePairs( start, static_cast<int>( end - start ), min_dist, max_dist, scratch.histogram.data(), scratch.indices.data() );
+    }
+    
+    /* Flush the histogram into the accumulation matrix */
+    float * accum_ptr = accum.ptr<float>(theta);
+    for( int i = 0; i < rhoMax; i++ )
+        accum_ptr[i] = scratch.histogram[i];
+}
+
+/**
+ * Check whether both orientations are mirror images of each other, along a symmetry line that mirrors
+ * an orientation o into (double_angle - o), modulo 180 degrees
+ */
+static inline bool isMirrored( float orientation_0, float orientation_1, float double_angle, float max_angle_diff ) {
+    /* All the angles are within [0, 180), so the difference is within (-180, 360) */
+    float diff = fabs( orientation_0 + orientation_1 - double_angle );
+    diff = MIN( MIN( diff, fabs( diff - 180.0f ) ), 360.0f - diff );
+    return diff <= max_angle_diff;
+}
+
+/**
+ * Vote for every pair of edge a and edge b where min_dist < b.x - a.x < max_dist, and both orientations are mirrored.
+ * Both arrays are sorted by their rotated x, and hold the orientations in y. When a and b are the same array,
+ * each pair is only visited once
+ */
+static inline void voteMirroredPairs( const Point2f * a, int n_a, const Point2f * b, int n_b, float min_dist, float max_dist,
+                                      float double_angle, float max_angle_diff, int * histogram ) {
+    const bool same = a == b;
+    int lo = 0, hi = 0;
+    
+    for( int i = 0; i < n_a; i++ ) {
+        const float x0 = a[i].x;
+        
+        if( same )
+            lo = MAX( lo, i + 1 );
+        while( lo < n_b && b[lo].x - x0 <= min_dist )
+            lo++;
+        
+        hi = MAX( hi, lo );
+        while( hi < n_b && b[hi].x - x0 < max_dist )
+            hi++;
+        
+        /* Branchless, since whether a pair is mirrored is hardly predictable */
+        for( int j = lo; j < hi; j++ )
+            histogram[static_cast<int>( x0 + b[j].x )] += isMirrored( a[i].y, b[j].y, double_angle, max_angle_diff );
+    }
+}
+
+/**
+ * Rotate the edges to the given theta, sort them by their rho and orientation buckets, and vote for the pairs
+ * of buckets whose orientations could be mirrored.
+ *
+ * With buckets of width w, and the mirrored orientation T = floor(double_angle / w), two edges from buckets b0 and b1
+ * can only be mirrored if (b0 + b1) modulo the number of buckets is one of T - 2, T - 1, T, T + 1
+ */
+void FastSymmetryDetector::voteGradientTheta( const vector<Point2f>& edges, const vector<float>& orientations, int no_of_bins, int theta,
+                                              float min_dist, float max_dist, float max_angle_diff, VotingScratch& scratch ) {
+    const float r0 = rotMatrices[theta].at<float>(0, 0);
+    const float r1 = rotMatrices[theta].at<float>(0, 1);
+    const float r2 = rotMatrices[theta].at<float>(1, 0);
+    const float r3 = rotMatrices[theta].at<float>(1, 1);
+    
+    const float half_diag   = cvRound(diagonal) * 0.5;
+    const float fourth_rho  = rhoMax * 0.25;
+    const int no_of_edges   = static_cast<int>( edges.size() );
+    const int no_of_rhos    = rhoDivision + 1;
+    const int no_of_buckets = no_of_rhos * no_of_bins;
+    const float bin_width   = 180.0f / no_of_bins;
+    
+    /* The angle of the same rotation matrices from the constructor */
+    float double_angle = fmodf( 2.0f * (180.0f / thetaMax) * (theta - thetaMax * 0.5f), 180.0f );
+    if( double_angle < 0.0f )
+        double_angle += 180.0f;
+    const int mirrored_bin = static_cast<int>( double_angle / bin_width ) % no_of_bins;
+    
+    scratch.rhos.resize( no_of_edges );
+    scratch.orientedXs.resize( no_of_edges );
+    scratch.bucketStarts.assign( no_of_buckets + 1, 0 );
+    scratch.histogram.assign( rhoMax, 0 );
+    
+    /* Counting sort the rotated edges by their rho first, then by their orientation */
+    for( int i = 0; i < no_of_edges; i++ ) {
+        int rho = r2 * edges[i].x + r3 * edges[i].y + half_diag;
+        int bin = MIN( static_cast<int>( orientations[i] / bin_width ), no_of_bins - 1 );
+        
+        scratch.rhos[i] = rho * no_of_bins + bin;
+        scratch.bucketStarts[scratch.rhos[i] + 1]++;
+    }
+    
+    for( int i = 0; i < no_of_buckets; i++ )
+        scratch.bucketStarts[i + 1] += scratch.bucketStarts[i];
+    
+    scratch.bucketEnds.assign( scratch.bucketStarts.begin(), scratch.bucketStarts.end() - 1 );
+    for( int i = 0; i < no_of_edges; i++ )
+        scratch.orientedXs[scratch.bucketEnds[scratch.rhos[i]]++] = Point2f( r0 * edges[i].x + r1 * edges[i].y + fourth_rho, orientations[i] );
+    
+    const Point2f * oriented_xs = scratch.orientedXs.data();
+    const int * starts          = scratch.bucketStarts.data();
+    int * histogram             = scratch.histogram.data();
+    
+    auto compareX = []( const Point2f& a, const Point2f& b ){ return a.x < b.x; };
+    
+    for( int rho = 0; rho < no_of_rhos; rho++ ) {
+        const int first = rho * no_of_bins;
+        
+        const int n = starts[first + no_of_bins] - starts[first];
+        
+        /* Ignore edges that have smaller number of pairings */
+        if( n <= 1 )
+            continue;
+        
+        /* With fewer edges than orientation buckets, going through the buckets costs more than simply checking every pair */
+        if( no_of_bins == 1 || n < no_of_bins ) {
+            sort( scratch.orientedXs.begin() + starts[first], scratch.orientedXs.begin() + starts[first] + n, compareX );
+            
+            const Point2f * a = oriented_xs + starts[first];
+            voteMirroredPairs( a, n, a, n, min_dist, max_dist, double_angle, max_angle_diff, histogram );
+            continue;
+        }
+        
+        for( int i = first; i < first + no_of_bins; i++ ) {
+            if( starts[i + 1] - starts[i] > 1 )
+                sort( scratch.orientedXs.begin() + starts[i], scratch.orientedXs.begin() + starts[i + 1], compareX );
+        }
+        
+        for( int b0 = 0; b0 < no_of_bins; b0++ ) {
+            const Point2f * a = oriented_xs + starts[first + b0];
+            const int n_a     = starts[first + b0 + 1] - starts[first + b0];
+            if( n_a == 0 )
+                continue;
+            
+            for( int offset = -2; offset <= 1; offset++ ) {
+                const int b1 = (mirrored_bin + offset - b0 + 2 * no_of_bins) % no_of_bins;
+                
+                const Point2f * b = oriented_xs + starts[first + b1];
+                const int n_b     = starts[first + b1 + 1] - starts[first + b1];
+                
+                /* Each pair of buckets is only visited once */
+                if( b1 < b0 || n_b == 0 )
+                    continue;
+                
+                voteMirroredPairs( a, n_a, b, n_b, min_dist, max_dist, double_angle, max_angle_diff, histogram );
+                if( b1 != b0 )
+                    voteMirroredPairs( b, n_b, a, n_a, min_dist, max_dist, double_angle, max_angle_diff, histogram );
+            }
+        }
+    }
+    
+    float * accum_ptr = accum.ptr<float>(theta);
+    for( int i = 0; i < rhoMax; i++ )
+        accum_ptr[i] = histogram[i];
+}
+
 /**
  * Retrieve the accumulation matrix
  */
@@ -132,72 +581,167 @@ Mat FastSymmetryDetector::getAccumulationMatrix( float thresh ) {
 vector<pair<Point, Point>> FastSymmetryDetector::getResult(int no_of_peaks, float threshold ) {
     vector<pair<Point, Point>> result;
     
+    /* Convert from Hough space back to x-y space */
+    for( Point peak: findPeaks( no_of_peaks, threshold ) )
+        result.push_back( getLine( peak.x, peak.y ) );
+    
+    return result;
+}
+
+/**
+ * Sliding maximum within [x - radius, x + radius] for each x of the given array, using the van Herk / Gil-Werman
+ * algorithm, which only needs 3 comparisons per element regardless of the radius. Elements outside of the array
+ * are treated as zero, since the accumulation matrix never goes below that
+ */
+static void slidingMax( const float * src, int n, int radius, float * dst, vector<float>& buffer ) {
+    const int width  = 2 * radius + 1;
+    const int padded = n + 2 * radius;
+    
+    buffer.resize( 3 * padded );
+    float * values = &buffer[0];
+    float * g      = values + padded;
+    float * h      = g + padded;
+    
+    fill( values, values + radius, 0.0f );
+    copy( src, src + n, values + radius );
+    fill( values + radius + n, values + padded, 0.0f );
+    
+    /* Running maximum from the start and from the end of each block of the window's width */
+    for( int block = 0; block < padded; block += width ) {
+        const int block_end = MIN( block + width, padded );
+        
+        g[block] = values[block];
+        for( int i = block + 1; i < block_end; i++ )
+            g[i] = MAX( g[i - 1], values[i] );
+        
+        h[block_end - 1] = values[block_end - 1];
+        for( int i = block_end - 2; i >= block; i-- )
+            h[i] = MAX( h[i + 1], values[i] );
+    }
+    
+    /* Every window spans at most two blocks, the end of one and the start of the next */
+    for( int x = 0; x < n; x++ )
+        dst[x] = MAX( h[x], g[x + width - 1] );
+}
+
+/**
+ * Find up to no_of_peaks local maxima of the accumulation matrix that are above the threshold, sorted by their votes,
+ * as (rho, theta) indices. Each peak is the maximum within rhoMax / 20 and thetaMax / 20 around itself, where the
+ * theta neighborhood wraps around the matrix with its rho mirrored, since rotating by 180 deg only flips the sign of rho.
+ *
+ * The maximum of every neighborhood is found with a separable sliding maximum, first along rho, then along theta,
+ * so the whole search is linear in the size of the accumulation matrix, and only the local maxima are sorted
+ */
+vector<Point> FastSymmetryDetector::findPeaks( int no_of_peaks, float threshold ) {
+    vector<Point> peaks;
+    
     /* Make sure that we have appropriate peaks */
     no_of_peaks = MAX( 0, no_of_peaks );
+    if( no_of_peaks == 0 )
+        return peaks;
     
     /* Pre-set the size of the neighbors */
-    int rho_neighbors   = rhoMax / 20.0f,
-        theta_neighbors = thetaMax / 20.0f;
-    
-    /* Create a mask to avoid searching peaks around the padding, and for everything that's below the specified
-     threshold */
-    Mat mask( accum.size(), CV_8UC1, Scalar(255) );
-    mask.row(0)             = Scalar(0);
-    mask.row(mask.rows - 1) = Scalar(0);
-    mask = mask & (accum >= threshold);
-    
-    Mat temp = accum.clone();
-    
-    
-    for( int peak = 0; peak < no_of_peaks; peak++ ) {
-        /* Find the peak from the Hough accumulation matrix */
-        double max_val;
-        Point max_loc;
-        minMaxLoc( temp, NULL, &max_val, NULL, &max_loc, mask );
-        
-        int rho_index   = max_loc.x;
-        int theta_index = max_loc.y;
-        
-        if( !within(rho_index, 0, rhoMax - 1))
-            break;
-        
-        if( !within(theta_index, 0, thetaMax))
-            break;
-        
-        /* Convert from Hough space back to x-y space */
-        result.push_back( getLine(rho_index, theta_index ));
-        
-        /* Try to zero out the peak and the neighborhood of the peak, so that */
-        /* we can move on to find the second highest peak */
-        int r0 = MAX( 0, rho_index - rho_neighbors );
-        int r1 = MIN( rhoMax - 1, rho_index + rho_neighbors );
-        int t0 = theta_index - theta_neighbors;
-        int t1 = theta_index + theta_neighbors;
-        
-        if( t0 <= 0 || t1 >= thetaMax + 1 ) {
-            /* Handles the edge case that wraps around the matrix */
-            Rect neighbor_1, neighbor_2;
-            if( t0 <= 0 ) {
-                neighbor_1 = Rect( r0, 0, r1 - r0, t1 );
-                r1 = rhoDivision - r1;
-                neighbor_2 = Rect( r1, t0 + thetaMax - 1, r1 - r0, thetaMax + 1 );
-            }
-            
-            if( t1 >= thetaMax + 1 ) {
-                neighbor_1 = Rect( r0, t0, r1 - r0, thetaMax + 1 );
-                neighbor_2 = Rect( r0, 0, r1 - r0, t1 - (thetaMax + 1) );
-            }
-            
-            rectangle( temp, neighbor_1, Scalar(0), CV_FILLED );
-            rectangle( temp, neighbor_2, Scalar(0), CV_FILLED );
+    const int rho_neighbors   = rhoMax / 20.0f;
+    const int theta_neighbors = MIN( static_cast<int>( thetaMax / 20.0f ), thetaMax - 1 );
+    const int theta_width     = 2 * theta_neighbors + 1;
+    
+    /* Only the rows of the actual thetas are voted for, the padding rows are left out. */
+    /* Each row of the extended matrix is the sliding maximum along rho of theta (row - theta_neighbors), */
+    /* and the rows beyond both ends are the wrapped around thetas, mirrored */
+    Mat extended( thetaMax + 2 * theta_neighbors, rhoMax, CV_32FC1 );
+    vector<float> mirrored( rhoMax ), buffer;
+    
+    for( int row = 0; row < extended.rows; row++ ) {
+        const int theta = row - theta_neighbors;
+        const float * accum_ptr = accum.ptr<float>( (theta + thetaMax) % thetaMax );
+        
+        if( theta < 0 || theta >= thetaMax ) {
+            reverse_copy( accum_ptr, accum_ptr + rhoMax, mirrored.begin() );
+            accum_ptr = &mirrored[0];
+        }
+        
+        slidingMax( accum_ptr, rhoMax, rho_neighbors, extended.ptr<float>(row), buffer );
+    }
+    
+    /* Same van Herk / Gil-Werman sliding maximum along theta, but a whole row at a time */
+    Mat g( extended.size(), CV_32FC1 ), h( extended.size(), CV_32FC1 );
+    for( int row = 0; row < extended.rows; row++ ) {
+        const float * extended_ptr = extended.ptr<float>(row);
+        float * g_ptr = g.ptr<float>(row);
+        
+        if( row % theta_width == 0 ) {
+            copy( extended_ptr, extended_ptr + rhoMax, g_ptr );
+            continue;
+        }
+        
+        const float * prev_ptr = g.ptr<float>(row - 1);
+        for( int rho = 0; rho < rhoMax; rho++ )
+            g_ptr[rho] = MAX( prev_ptr[rho], extended_ptr[rho] );
+    }
+    
+    for( int row = extended.rows - 1; row >= 0; row-- ) {
+        const float * extended_ptr = extended.ptr<float>(row);
+        float * h_ptr = h.ptr<float>(row);
+        
+        if( row % theta_width == theta_width - 1 || row == extended.rows - 1 ) {
+            copy( extended_ptr, extended_ptr + rhoMax, h_ptr );
+            continue;
         }
-        else {
-            rectangle( temp, Rect(r0, t0, r1 - r0, t1 - t0), Scalar(0), CV_FILLED );
+        
+        const float * next_ptr = h.ptr<float>(row + 1);
+        for( int rho = 0; rho < rhoMax; rho++ )
+            h_ptr[rho] = MAX( next_ptr[rho], extended_ptr[rho] );
+    }
+    
+    /* A local maximum is where the accumulation matrix equals the maximum of its neighborhood */
+    vector<pair<float, Point>> candidates;
+    for( int theta = 0; theta < thetaMax; theta++ ) {
+        const float * accum_ptr = accum.ptr<float>(theta);
+        const float * h_ptr     = h.ptr<float>(theta);
+        const float * g_ptr     = g.ptr<float>(theta + theta_width - 1);
+        
+        for( int rho = 0; rho < rhoMax; rho++ ) {
+            const float val = accum_ptr[rho];
+            if( val > 0.0f && val >= threshold && val >= MAX( h_ptr[rho], g_ptr[rho] ) )
+                candidates.push_back( make_pair( val, Point(rho, theta) ) );
         }
     }
     
+    auto higher_votes = []( const pair<float, Point>& a, const pair<float, Point>& b ) {
+        if( a.first != b.first )
+            return a.first > b.first;
+        return a.second.y != b.second.y ? a.second.y < b.second.y : a.second.x < b.second.x;
+    };
     
-    return result;
+    /* Check whether the peak is within the neighborhood of another peak */
+    auto is_neighbor = [&]( Point a, Point b ) {
+        int theta_diff = abs( a.y - b.y );
+        if( theta_diff > thetaMax / 2 )
+            return thetaMax - theta_diff <= theta_neighbors && abs( (rhoMax - 1 - a.x) - b.x ) <= rho_neighbors;
+        return theta_diff <= theta_neighbors && abs( a.x - b.x ) <= rho_neighbors;
+    };
+    
+    /* Plateaus could give more than one local maximum within the same neighborhood, so only keep the first of them. */
+    /* Usually there's none, so only the top no_of_peaks are sorted first, and the rest only if it's needed */
+    size_t sorted = MIN( candidates.size(), static_cast<size_t>( no_of_peaks ) );
+    partial_sort( candidates.begin(), candidates.begin() + sorted, candidates.end(), higher_votes );
+    
+    for( size_t i = 0; i < candidates.size() && static_cast<int>( peaks.size() ) < no_of_peaks; i++ ) {
+        if( i == sorted ) {
+            sort( candidates.begin() + sorted, candidates.end(), higher_votes );
+            sorted = candidates.size();
+        }
+        
+        const Point candidate = candidates[i].second;
+        bool suppressed = false;
+        for( Point peak: peaks )
+            suppressed = suppressed || is_neighbor( peak, candidate );
+        
+        if( !suppressed )
+            peaks.push_back( candidate );
+    }
+    
+    return peaks;
 }
 
 
@@ -38,14 +38,47 @@ class FastSymmetryDetector {
 public:
     FastSymmetryDetector( const Size image_size, const Size hough_size, const int rot_resolution = 1 );
     void vote( Mat& image, int min_pair_dist, int max_pair_dist  );
+    void voteSorted( Mat& image, int min_pair_dist, int max_pair_dist );
+    void voteParallel( Mat& image, int min_pair_dist, int max_pair_dist );
+    void voteGradient( Mat& image, Mat& orientation, int min_pair_dist, int max_pair_dist, float max_angle_diff = 10.0f );
     inline void rotateEdges( vector<Point2f>& edges, int theta );
     
+    bool track( Mat& image, int min_pair_dist, int max_pair_dist, float min_votes );
+    void setTrackingWindow( int theta_window, int rho_window );
+    void resetTracking();
+    bool isTracking();
+    pair<Point, Point> getTrackedLine();
+    
     Mat getAccumulationMatrix( float thresh = 0.0 );
     
     vector<pair<Point, Point>> getResult( int no_of_peaks, float threshold = -1.0f );
+    vector<Point> findPeaks( int no_of_peaks, float threshold = -1.0f );
     pair<Point, Point> getLine( float rho, float theta );
     
+protected:
+    /* Buffers used to vote for a single theta, kept around so that nothing is allocated per theta */
+    struct VotingScratch {
+        vector<int> rhos;
+        vector<int> bucketStarts;
+        vector<int> bucketEnds;
+        vector<float> xs;
+        vector<int> indices;
+        vector<int> histogram;
+        
+        /* Rotated x of each edge along with its orientation, for the gradient voting */
+        vector<Point2f> orientedXs;
+    };
+    
+    void findEdges( Mat& image, vector<Point2f>& edges );
+    void findEdges( Mat& image, Mat& orientation, vector<Point2f>& edges, vector<float>& orientations );
+    void voteTheta( const vector<Point2f>& edges, int theta, float min_dist, float max_dist, VotingScratch& scratch );
+    void voteGradientTheta( const vector<Point2f>& edges, const vector<float>& orientations, int no_of_bins, int theta,
+                            float min_dist, float max_dist, float max_angle_diff, VotingScratch& scratch );
+    bool findTrackedPeak( float min_votes );
+    
 private:
+    VotingScratch scratch;
+    tbb::enumerable_thread_specific<VotingScratch> threadScratch;
     vector<Mat> rotMatrices;
     Mat rotEdges;
     vector<float*> reRows;
@@ -57,6 +90,12 @@ private:
     int rhoDivision;
     int rhoMax;
     int thetaMax;
+    
+    /* The tracked symmetry line, as (rho, theta) index of the accumulation matrix */
+    bool tracking;
+    Point trackedPeak;
+    int thetaWindow;
+    int rhoWindow;
 };
 
 #endif /* defined(__FSD__FastSymmetryDetector__) */
@@ -58,14 +58,22 @@ void testVideo() {
     int min_pair_dist  = 25;
     int max_pair_dist  = 500;
     int no_of_peaks    = 1;
+    int min_track_votes = 100;
     
     createTrackbar( "canny_thresh_1", "", &canny_thresh_1, 500 );
     createTrackbar( "canny_thresh_2", "", &canny_thresh_2, 500 );
     createTrackbar( "min_pair_dist", "", &min_pair_dist, 500 );
     createTrackbar( "max_pair_dist", "", &max_pair_dist, 500 );
     createTrackbar( "no_of_peaks", "", &no_of_peaks, 10 );
+    createTrackbar( "min_track_votes", "", &min_track_votes, 2000 );
     
-    Mat edge;
+    /* Press 's' to switch between the sorted and the original voting, and 'g' to only vote for mirrored gradients. */
+    /* Press 't' to track the most prominent symmetry line over the frames instead */
+    bool sorted_voting   = true;
+    bool gradient_voting = false;
+    bool tracking_mode   = false;
+    
+    Mat edge, grad_x, grad_y, orientation;
     while( true ){
         cap >> frame;
         flip( frame, frame, 1 );
@@ -73,16 +81,43 @@ void testVideo() {
         
         /* Find the edges of the image */
         cvtColor( frame, edge, CV_BGR2GRAY );
+        if( gradient_voting ) {
+            Sobel( edge, grad_x, CV_32F, 1, 0 );
+            Sobel( edge, grad_y, CV_32F, 0, 1 );
+            phase( grad_x, grad_y, orientation, true );
+        }
         Canny( edge, edge, canny_thresh_1, canny_thresh_2 );
         
         /* Vote for the hough matrix */
-        detector.vote( edge, min_pair_dist, max_pair_dist );
+        int64 start = getTickCount();
+        bool tracked = false;
+        if( tracking_mode )
+            tracked = detector.track( edge, min_pair_dist, max_pair_dist, min_track_votes );
+        else if( gradient_voting )
+            detector.voteGradient( edge, orientation, min_pair_dist, max_pair_dist );
+        else if( sorted_voting )
+            detector.voteParallel( edge, min_pair_dist, max_pair_dist );
+        else
+            detector.vote( edge, min_pair_dist, max_pair_dist );
+        double vote_ms = (getTickCount() - start) * 1000.0 / getTickFrequency();
+        
         Mat accum = detector.getAccumulationMatrix();
         
         /* Get the result and draw the symmetrical line */
-        vector<pair<Point, Point>> result = detector.getResult( no_of_peaks );
+        vector<pair<Point, Point>> result;
+        if( tracking_mode ) {
+            if( tracked )
+                result.push_back( detector.getTrackedLine() );
+        }
+        else
+            result = detector.getResult( no_of_peaks );
+        
         for( auto point_pair: result )
             line(frame, point_pair.first, point_pair.second, Scalar(0, 0, 255), 3);
+        
+        string mode = tracking_mode ? "tracking" : gradient_voting ? "gradient" : sorted_voting ? "sorted" : "original";
+        putText( frame, format( "%s voting: %.1f ms", mode.c_str(), vote_ms ),
+                 Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.7, Scalar(0, 255, 0), 2 );
 
         /* Convert our Hough accum matrix to heat map */
         accum.convertTo( accum, CV_8UC3 );
@@ -97,8 +132,18 @@ void testVideo() {
 
         
         imshow( "", appended );
-        if(waitKey(10) == 'q')
+        
+        char key = waitKey(10);
+        if( key == 'q' )
             break;
+        if( key == 's' )
+            sorted_voting = !sorted_voting;
+        if( key == 'g' )
+            gradient_voting = !gradient_voting;
+        if( key == 't' ) {
+            tracking_mode = !tracking_mode;
+            detector.resetTracking();
+        }
     }
 }
 
@@ -0,0 +1,274 @@
+//
+//  CircleHough.cpp
+//  TestHough
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#include "CircleHough.h"
+#include <tbb/tbb.h>
+
+CircleHough::CircleHough( int resolution, size_t memory_budget ) {
+    this->resolution    = MAX( 1, resolution );
+    this->memoryBudget  = memory_budget;
+    this->accumCols     = 0;
+    this->accumRows     = 0;
+}
+
+CircleHough::~CircleHough() {
+}
+
+/**
+ * Find the circles with radius between min_radius and max_radius (inclusive), that got at least thresh votes,
+ * from the edge image and its Sobel derivatives. Each circle is a peak that's not smaller than anything within
+ * nms_radius center bins and 1 radius around it. Returns the circles sorted by their votes, at most max_circles of
+ * them if it's positive
+ */
+vector<HoughCircle> CircleHough::findCircles( Mat& src, Mat& grad_x, Mat& grad_y, int min_radius, int max_radius,
+                                              float thresh, int max_circles, int nms_radius ) {
+    vector<Point> pixels;
+    vector<Point2f> normals;
+    findEdgePixels( src, grad_x, grad_y, pixels, normals );
+    
+    vector<HoughCircle> circles;
+    for( const Peak& peak: detect( pixels, normals, min_radius, max_radius, thresh, nms_radius, max_circles ) )
+        circles.push_back( HoughCircle( Point2f( peak.a * resolution, peak.b * resolution ), peak.radius, peak.votes ) );
+    
+    return circles;
+}
+
+/**
+ * Find the ellipses with major semi-axis between min_axis and max_axis (inclusive), that got at least thresh votes.
+ * The circle voting is repeated for no_of_angles orientations over 180 degrees, and for no_of_ratios ratios of
+ * minor to major axis, from min_ratio up to 1. Overlapping detections from different orientations and ratios
+ * are suppressed, the stronger one wins. Returns the ellipses sorted by their votes, at most max_ellipses of them
+ * if it's positive
+ */
+vector<HoughEllipse> CircleHough::findEllipses( Mat& src, Mat& grad_x, Mat& grad_y, int min_axis, int max_axis,
+                                                float thresh, int max_ellipses, int no_of_angles,
+                                                int no_of_ratios, float min_ratio ) {
+    no_of_angles = MAX( 1, no_of_angles );
+    no_of_ratios = MAX( 1, no_of_ratios );
+    min_ratio    = MIN( MAX( min_ratio, 0.05f ), 1.0f );
+    
+    vector<Point> pixels;
+    vector<Point2f> normals;
+    findEdgePixels( src, grad_x, grad_y, pixels, normals );
+    
+    vector<HoughEllipse> candidates;
+    vector<Point2f> directions( normals.size() );
+    
+    for( int j = 0; j < no_of_ratios; j++ ) {
+        float ratio = no_of_ratios == 1 ? 1.0f : min_ratio + (1.0f - min_ratio) * j / (no_of_ratios - 1);
+        
+        /* A circle looks the same in every orientation */
+        int no_of_orientations = ratio >= 1.0f ? 1 : no_of_angles;
+        
+        for( int i = 0; i < no_of_orientations; i++ ) {
+            float angle = 180.0f * i / no_of_angles;
+            float cos_a = cosf( angle * M_PI / 180.0 );
+            float sin_a = sinf( angle * M_PI / 180.0 );
+            
+            /* Rotate each normal into the ellipse's frame, and stretch it along with the minor axis, */
+            /* which gives the normal of the circle. The offset to the center, per unit of major semi-axis, */
+            /* is that normal squashed back and rotated into the image again */
+            tbb::parallel_for( tbb::blocked_range<size_t>( 0, normals.size(), 4096 ), [&]( const tbb::blocked_range<size_t>& range ) {
+                for( size_t k = range.begin(); k != range.end(); k++ ) {
+                    const Point2f normal = normals[k];
+                    float nx =  cos_a * normal.x + sin_a * normal.y;
+                    float ny = (-sin_a * normal.x + cos_a * normal.y) * ratio;
+                    float length = sqrtf( nx * nx + ny * ny );
+                    
+                    float ox = nx / length;
+                    float oy = ny / length * ratio;
+                    directions[k] = Point2f( cos_a * ox - sin_a * oy, sin_a * ox + cos_a * oy );
+                }
+            });
+            
+            for( const Peak& peak: detect( pixels, directions, min_axis, max_axis, thresh, 2, 0 ) ) {
+                RotatedRect box( Point2f( peak.a * resolution, peak.b * resolution ),
+                                 Size2f( 2.0f * peak.radius, 2.0f * peak.radius * ratio ), angle );
+                candidates.push_back( HoughEllipse( box, peak.votes ) );
+            }
+        }
+    }
+    
+    sortPeaks( candidates, 0, []( const HoughEllipse& a, const HoughEllipse& b ) {
+        if( a.box.center.y != b.box.center.y )
+            return a.box.center.y < b.box.center.y;
+        if( a.box.center.x != b.box.center.x )
+            return a.box.center.x < b.box.center.x;
+        if( a.box.size.width != b.box.size.width )
+            return a.box.size.width < b.box.size.width;
+        return a.box.size.height != b.box.size.height ? a.box.size.height < b.box.size.height : a.box.angle < b.box.angle;
+    });
+    
+    /* Drop the ellipses centered within the minor semi-axis of a stronger one */
+    vector<HoughEllipse> ellipses;
+    for( const HoughEllipse& candidate: candidates ) {
+        bool is_overlapping = false;
+        for( const HoughEllipse& ellipse: ellipses ) {
+            Point2f delta = candidate.box.center - ellipse.box.center;
+            float min_distance = 0.5f * ellipse.box.size.height;
+            if( delta.x * delta.x + delta.y * delta.y < min_distance * min_distance ) {
+                is_overlapping = true;
+                break;
+            }
+        }
+        
+        if( !is_overlapping )
+            ellipses.push_back( candidate );
+        
+        if( max_ellipses > 0 && static_cast<int>( ellipses.size() ) == max_ellipses )
+            break;
+    }
+    
+    return ellipses;
+}
+
+/**
+ * Find the non zero pixels of the edge image that have a gradient, along with their unit gradient directions.
+ * Sets up the size of the accumulator planes for this image
+ */
+void CircleHough::findEdgePixels( Mat& src, Mat& grad_x, Mat& grad_y, vector<Point>& pixels, vector<Point2f>& normals ) {
+    CV_Assert( grad_x.size() == src.size() && grad_y.size() == src.size() );
+    CV_Assert( grad_x.type() == grad_y.type() && (grad_x.type() == CV_32FC1 || grad_x.type() == CV_16SC1) );
+    
+    /* Centers are allowed anywhere inside the image */
+    accumCols = cvRound( (src.cols - 1) / static_cast<float>( resolution ) ) + 1;
+    accumRows = cvRound( (src.rows - 1) / static_cast<float>( resolution ) ) + 1;
+    
+    vector<Point> non_zero_pixels;
+    cv::findNonZero( src, non_zero_pixels );
+    
+    /* Only the gradients of the edge pixels are needed, so don't convert the whole derivative images */
+    const bool is_float = grad_x.type() == CV_32FC1;
+    
+    pixels.clear();
+    normals.clear();
+    for( const Point& pixel: non_zero_pixels ) {
+        float gx = is_float ? grad_x.at<float>( pixel ) : grad_x.at<short>( pixel );
+        float gy = is_float ? grad_y.at<float>( pixel ) : grad_y.at<short>( pixel );
+        float magnitude = sqrtf( gx * gx + gy * gy );
+        
+        if( magnitude > 0.0f ) {
+            pixels.push_back( pixel );
+            normals.push_back( Point2f( gx / magnitude, gy / magnitude ) );
+        }
+    }
+}
+
+/**
+ * Vote for the centers at each radius along the given directions, in both ways, and find the peaks of the
+ * (a, b, r) accumulator. The radii are processed in slabs that fit in the memory budget, each slab also has
+ * the radius before and after it, so that its peaks are compared with all of their neighbors.
+ * Returns the peaks sorted by their votes, at most max_peaks of them if it's positive
+ */
+vector<CircleHough::Peak> CircleHough::detect( const vector<Point>& pixels, const vector<Point2f>& directions,
+                                               int min_radius, int max_radius, float thresh, int nms_radius, int max_peaks ) {
+    vector<Peak> peaks;
+    
+    min_radius = MAX( 1, min_radius );
+    if( pixels.empty() || max_radius < min_radius )
+        return peaks;
+    
+    const size_t plane_size   = static_cast<size_t>( accumCols ) * accumRows;
+    const int spatial_radius  = MAX( 0, nms_radius );
+    
+    /* Can't go below 3 planes, a slab needs at least one radius with its neighbors */
+    int no_of_planes    = static_cast<int>( MIN( memoryBudget / (plane_size * sizeof(int)), static_cast<size_t>( max_radius - min_radius + 3 ) ) );
+    no_of_planes        = MAX( 3, no_of_planes );
+    const int depth     = no_of_planes - 2;
+    
+    if( accum.size() < no_of_planes * plane_size )
+        accum = vector<atomic<int>>( no_of_planes * plane_size );
+    
+    tbb::enumerable_thread_specific<vector<Peak>> local_peaks;
+    
+    for( int first = min_radius; first <= max_radius; first += depth ) {
+        const int last      = MIN( first + depth - 1, max_radius );
+        const int lowest    = first - 1;
+        const int highest   = last + 1;
+        
+        tbb::parallel_for( tbb::blocked_range<size_t>( 0, (highest - lowest + 1) * plane_size, 1 << 16 ), [&]( const tbb::blocked_range<size_t>& range ) {
+            for( size_t i = range.begin(); i != range.end(); i++ )
+                accum[i].store( 0, memory_order_relaxed );
+        });
+        
+        tbb::parallel_for( tbb::blocked_range<size_t>( 0, pixels.size(), 256 ), [&]( const tbb::blocked_range<size_t>& range ) {
+            for( size_t i = range.begin(); i != range.end(); i++ ) {
+                const float x = pixels[i].x;
+                const float y = pixels[i].y;
+                const Point2f direction = directions[i];
+                
+                for( int radius = MAX( 1, lowest ); radius <= highest; radius++ ) {
+                    atomic<int> * plane = &accum[(radius - lowest) * plane_size];
+                    
+                    /* The gradient could point either towards the center or away from it */
+                    for( int sign = -1; sign <= 1; sign += 2 ) {
+                        int a = cvRound( (x + sign * radius * direction.x) / resolution );
+                        int b = cvRound( (y + sign * radius * direction.y) / resolution );
+                        
+                        if( a >= 0 && a < accumCols && b >= 0 && b < accumRows )
+                            plane[b * accumCols + a].fetch_add( 1, memory_order_relaxed );
+                    }
+                }
+            }
+        });
+        
+        /* Find the peaks of the slab, without its extra radii */
+        tbb::parallel_for( tbb::blocked_range<int>( 0, (last - first + 1) * accumRows, 16 ), [&]( const tbb::blocked_range<int>& range ) {
+            vector<Peak>& local = local_peaks.local();
+            
+            for( int row = range.begin(); row != range.end(); row++ ) {
+                const int radius = first + row / accumRows;
+                const int b      = row % accumRows;
+                const atomic<int> * plane = &accum[(radius - lowest) * plane_size];
+                
+                for( int a = 0; a < accumCols; a++ ) {
+                    const int votes = plane[b * accumCols + a].load( memory_order_relaxed );
+                    if( votes < thresh || votes <= 0 )
+                        continue;
+                    
+                    bool is_peak = true;
+                    for( int dr = -1; dr <= 1 && is_peak; dr++ ) {
+                        const atomic<int> * neighbor_plane = plane + dr * static_cast<ptrdiff_t>( plane_size );
+                        
+                        for( int db = -spatial_radius; db <= spatial_radius && is_peak; db++ ) {
+                            if( b + db < 0 || b + db >= accumRows )
+                                continue;
+                            
+                            for( int da = -spatial_radius; da <= spatial_radius; da++ ) {
+                                if( (dr == 0 && db == 0 && da == 0) || a + da < 0 || a + da >= accumCols )
+                                    continue;
+                                
+                                /* Ties go to whichever bin comes first in the accumulator */
+                                int neighbor   = neighbor_plane[(b + db) * accumCols + a + da].load( memory_order_relaxed );
+                                bool is_before = dr < 0 || (dr == 0 && (db < 0 || (db == 0 && da < 0)));
+                                if( neighbor > votes || (neighbor == votes && is_before) ) {
+                                    is_peak = false;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                    
+                    if( is_peak )
+                        local.push_back( Peak( a, b, radius, votes ) );
+                }
+            }
+        });
+    }
+    
+    for( const vector<Peak>& local: local_peaks )
+        peaks.insert( peaks.end(), local.begin(), local.end() );
+    
+    sortPeaks( peaks, max_peaks, []( const Peak& p, const Peak& q ) {
+        if( p.radius != q.radius )
+            return p.radius < q.radius;
+        return p.b != q.b ? p.b < q.b : p.a < q.a;
+    });
+    
+    return peaks;
+}
@@ -0,0 +1,93 @@
+//
+//  CircleHough.h
+//  TestHough
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __TestHough__CircleHough__
+#define __TestHough__CircleHough__
+
+#include <iostream>
+#include <atomic>
+#include <opencv2/opencv.hpp>
+
+#include "Hough.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * A circle found in the accumulator, with the number of votes it got
+ */
+struct HoughCircle {
+    Point2f center;
+    float radius;
+    float votes;
+    
+    HoughCircle( Point2f center, float radius, float votes ) : center( center ), radius( radius ), votes( votes ) {}
+};
+
+/**
+ * An ellipse found in the accumulator, the width of the box is its major axis
+ */
+struct HoughEllipse {
+    RotatedRect box;
+    float votes;
+    
+    HoughEllipse( RotatedRect box, float votes ) : box( box ), votes( votes ) {}
+};
+
+/**
+ * Gradient directed Hough transform for circles, in a 3D (a, b, r) accumulator of center and radius.
+ *
+ * Instead of voting for a whole cone of centers, each edge pixel only votes for the two centers along its
+ * gradient direction, one on each side, for every radius. The accumulator is never allocated for all the radii,
+ * it's streamed over slabs of consecutive radii, as many as fit in the memory budget, with one extra radius on
+ * each side so that the peaks of the slab can be compared with their neighbors across the slab boundaries.
+ *
+ * Ellipses are found by running the same circle voting in a stretched space, for a number of orientations
+ * and axis ratios. Under the affine map that scales an ellipse's minor axis up to its major axis, the ellipse
+ * becomes a circle, so its center and major axis are found as the peak of the circle accumulator
+ */
+class CircleHough {
+public:
+    CircleHough( int resolution = 1, size_t memory_budget = 192 << 20 );
+    ~CircleHough();
+    
+    vector<HoughCircle> findCircles( Mat& src, Mat& grad_x, Mat& grad_y, int min_radius, int max_radius,
+                                     float thresh, int max_circles = 0, int nms_radius = 2 );
+    
+    vector<HoughEllipse> findEllipses( Mat& src, Mat& grad_x, Mat& grad_y, int min_axis, int max_axis,
+                                       float thresh, int max_ellipses = 0, int no_of_angles = 8,
+                                       int no_of_ratios = 4, float min_ratio = 0.4f );
+
+protected:
+    /* A peak in the accumulator, with its center in accumulator bins */
+    struct Peak {
+        int a, b, radius;
+        float votes;
+        
+        Peak( int a, int b, int radius, float votes ) : a( a ), b( b ), radius( radius ), votes( votes ) {}
+    };
+    
+    void findEdgePixels( Mat& src, Mat& grad_x, Mat& grad_y, vector<Point>& pixels, vector<Point2f>& normals );
+    vector<Peak> detect( const vector<Point>& pixels, const vector<Point2f>& directions, int min_radius, int max_radius,
+                         float thresh, int nms_radius, int max_peaks );
+    
+    /* Size of each accumulator bin in pixels */
+    int resolution;
+    
+    /* Upper bound of the accumulator in bytes, by default it leaves room for the rest of a 4K frame within 256 MB */
+    size_t memoryBudget;
+    
+    /* Number of bins of each radius plane */
+    int accumCols, accumRows;
+    
+    /* Radius planes of the current slab, one after another. Votes are sparse, */
+    /* so all threads share the same planes, and each vote is a single atomic increment */
+    vector<atomic<int>> accum;
+};
+
+#endif /* defined(__TestHough__CircleHough__) */
@@ -9,13 +9,20 @@
 #include "Hough.h"
 #include <tbb/tbb.h>
 
-Hough::Hough() {
-    cosines.reserve( thetaMax );
-    sines.reserve( thetaMax );
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+Hough::Hough( int theta_max ) {
+    thetaMax = MAX( 1, theta_max );
+    cosines.resize( thetaMax );
+    sines.resize( thetaMax );
 
     /* Pre calc the cosines and sines */
     for( int theta = 0; theta < thetaMax; theta++ ){
-        float theta_rad = theta * M_PI / 180.0;
+        float theta_rad = theta * M_PI / thetaMax;
         cosines[theta]  = cosf( theta_rad );
         sines[theta]    = sinf( theta_rad );
     }
@@ -24,39 +31,317 @@ Hough::Hough() {
 Hough::~Hough() {
 }
 
+/**
+ * Vote for every theta of a single pixel, where votes points to the first row of the accumulator,
+ * and step is the number of ints between its rows. The rhos are computed 8 thetas at a time with AVX,
+ * or 4 at a time with SSE2, and the remaining thetas one by one
+ **/
+static inline void votePixel( float dx, float dy, const float * cosines, const float * sines, int theta_max, int rho_range,
+                              int * votes, size_t step ) {
+    int theta = 0;
+    
+#ifdef __AVX__
+    const __m256 dx_8  = _mm256_set1_ps( dx );
+    const __m256 dy_8  = _mm256_set1_ps( dy );
+    const __m256 rho_8 = _mm256_set1_ps( rho_range );
+    alignas(32) int rho_indices[8];
+    
+    for( ; theta + 8 <= theta_max; theta += 8 ) {
+        __m256 r = _mm256_add_ps( _mm256_mul_ps( dx_8, _mm256_load_ps( cosines + theta ) ),
+                                  _mm256_mul_ps( dy_8, _mm256_load_ps( sines + theta ) ) );
+        _mm256_store_si256( reinterpret_cast<__m256i *>( rho_indices ), _mm256_cvttps_epi32( _mm256_add_ps( rho_8, r ) ) );
+        
+        for( int i = 0; i < 8; i++ )
+            votes[rho_indices[i] * step + theta + i]++;
+    }
+#elif defined(__SSE2__)
+    const __m128 dx_4  = _mm_set1_ps( dx );
+    const __m128 dy_4  = _mm_set1_ps( dy );
+    const __m128 rho_4 = _mm_set1_ps( rho_range );
+    alignas(16) int rho_indices[4];
+    
+    for( ; theta + 4 <= theta_max; theta += 4 ) {
+        __m128 r = _mm_add_ps( _mm_mul_ps( dx_4, _mm_load_ps( cosines + theta ) ),
+                               _mm_mul_ps( dy_4, _mm_load_ps( sines + theta ) ) );
+        _mm_store_si128( reinterpret_cast<__m128i *>( rho_indices ), _mm_cvttps_epi32( _mm_add_ps( rho_4, r ) ) );
+        
+        for( int i = 0; i < 4; i++ )
+            votes[rho_indices[i] * step + theta + i]++;
+    }
+#endif
+    
+    for( ; theta < theta_max; theta++ ) {
+        float r         = dx * cosines[theta] + dy * sines[theta];
+        int rho_index   = rho_range + r;
+        votes[rho_index * step + theta]++;
+    }
+}
+
+/**
+ * Let vote_pixel( i, votes, step ) vote for each of the pixels, where votes points to the first row of an integer accumulator,
+ * and step is the number of ints between its rows. Each thread votes into its own accumulator, and they are only summed
+ * into the accumulation matrix at the end, so no vote is lost to a race, and since integer additions are exact,
+ * the result doesn't depend on how the pixels are split among the threads
+ **/
+template <typename PixelVoter>
+void Hough::accumulate( size_t no_of_pixels, PixelVoter vote_pixel ) {
+    tbb::enumerable_thread_specific<Mat> local_accums( [&]() {
+        return Mat( Mat::zeros( accum.size(), CV_32SC1 ) );
+    });
+    
+    tbb::parallel_for( tbb::blocked_range<size_t>( 0, no_of_pixels, 256 ), [&]( const tbb::blocked_range<size_t>& range ) {
+        Mat& local_accum = local_accums.local();
+        int * votes      = local_accum.ptr<int>(0);
+        size_t step      = local_accum.step / sizeof(int);
+        
+        for( size_t i = range.begin(); i != range.end(); i++ )
+            vote_pixel( i, votes, step );
+    });
+    
+    /* Merge the accumulators, each thread sums up its own block of rows */
+    tbb::parallel_for( tbb::blocked_range<int>( 0, accum.rows, 16 ), [&]( const tbb::blocked_range<int>& range ) {
+        for( int rho_index = range.begin(); rho_index != range.end(); rho_index++ ) {
+            float * accum_ptr = accum.ptr<float>(rho_index);
+            
+            for( const Mat& local_accum: local_accums ) {
+                const int * local_ptr = local_accum.ptr<int>(rho_index);
+                for( int theta = 0; theta < thetaMax; theta++ )
+                    accum_ptr[theta] += local_ptr[theta];
+            }
+        }
+    });
+}
+
 /**
  * Initialize the accumulation matrix
  **/
 void Hough::init(Mat &src){
+    vector<Point> non_zero_pixels;
+    createAccumulator( src, non_zero_pixels );
+    
+    vote( non_zero_pixels );
+}
+
+/**
+ * Same as init(), but each edge pixel only votes for the thetas within theta_window bins of its gradient direction,
+ * since the gradient is the normal of the line that the pixel could belong to. grad_x and grad_y are the derivatives
+ * from Sobel(), and if weighted, each vote counts as the rounded gradient magnitude instead of 1
+ **/
+void Hough::initGradient( Mat& src, Mat& grad_x, Mat& grad_y, int theta_window, bool weighted ) {
+    CV_Assert( grad_x.size() == src.size() && grad_y.size() == src.size() );
+    
+    vector<Point> non_zero_pixels;
+    createAccumulator( src, non_zero_pixels );
+    
+    Mat dx, dy;
+    grad_x.convertTo( dx, CV_32F );
+    grad_y.convertTo( dy, CV_32F );
+    
+    /* Each theta should only be voted once per pixel */
+    theta_window = MIN( MAX( 0, theta_window ), (thetaMax - 1) / 2 );
+    
+    accumulate( non_zero_pixels.size(), [&]( size_t i, int * votes, size_t step ) {
+        const Point pixel = non_zero_pixels[i];
+        const float gx    = dx.at<float>( pixel );
+        const float gy    = dy.at<float>( pixel );
+        
+        float delta_y = pixel.y - centerY;
+        float delta_x = pixel.x - centerX;
+        
+        /* Without any gradient, there's no direction to go by */
+        if( gx == 0.0f && gy == 0.0f ) {
+            if( !weighted )
+                votePixel( delta_x, delta_y, &cosines[0], &sines[0], thetaMax, rhoRange, votes, step );
+            return;
+        }
+        
+        const int weight        = weighted ? cvRound( sqrtf( gx * gx + gy * gy ) ) : 1;
+        const int center_theta  = cvRound( atan2f( gy, gx ) * thetaMax / M_PI );
+        
+        for( int offset = -theta_window; offset <= theta_window; offset++ ) {
+            /* Gradients pointing the other way describe the same lines, with negated rho, so the bins simply wrap around */
+            int theta       = ((center_theta + offset) % thetaMax + thetaMax) % thetaMax;
+            float r         = delta_x * cosines[theta] + delta_y * sines[theta];
+            int rho_index   = rhoRange + r;
+            votes[rho_index * step + theta] += weight;
+        }
+    });
+}
+
+/**
+ * Normalize the edge image, create the empty accumulation matrix for its size, and find all its edge pixels
+ **/
+void Hough::createAccumulator( Mat& src, vector<Point>& pixels ) {
     imageSize = src.size();
     
     /* Normalized so that the matrix values are either 0 or 255 */
     Mat image;
     normalize( src, image, 0, 255, NORM_MINMAX );
     
-    /* Create the accumulator matrix */
-    this->rhoRange = MAX( image.cols, image.rows ) * 0.70710678; /* 0.70710678 is SQRT(2.0) / 2.0 */
+    /* Create the accumulator matrix, rho can go as far as half of the diagonal, plus one for the rounding */
+    this->rhoRange = cvCeil( hypotf( image.cols, image.rows ) * 0.5f ) + 1;
     this->accum = Mat::zeros( rhoRange * 2, thetaMax, CV_32FC1 );
     
     this->centerX = image.cols / 2;
     this->centerY = image.rows / 2;
     
     /* Find all non zero pixels */
-    vector<Point> non_zero_pixels;
-    cv::findNonZero( image, non_zero_pixels );
+    cv::findNonZero( image, pixels );
+}
+
+/**
+ * Vote for every theta of each of the given pixels
+ **/
+void Hough::vote( const vector<Point>& pixels ) {
+    accumulate( pixels.size(), [&]( size_t i, int * votes, size_t step ) {
+        float dy = pixels[i].y - centerY;
+        float dx = pixels[i].x - centerX;
+        
+        votePixel( dx, dy, &cosines[0], &sines[0], thetaMax, rhoRange, votes, step );
+    });
+}
+
+/**
+ * Progressive probabilistic Hough transform, "Robust Detection of Lines Using the Progressive Probabilistic
+ * Hough Transform" by Matas, Galambos and Kittler. Edge pixels vote one at a time in random order, and as soon as
+ * a bin crosses thresh, the edge map is walked along that line from the last voted pixel, allowing gaps of
+ * up to max_gap pixels, to find the segment's endpoints. Pixels along the segment are then removed from the
+ * edge map, and their votes taken back out of the accumulator, so they won't be found again.
+ * Segments shorter than min_length are dropped. The accumulation matrix is left with the votes of
+ * the remaining pixels
+ **/
+vector<pair<Point, Point>> Hough::detectSegments( Mat& src, int thresh, int min_length, int max_gap, uint64 seed ) {
+    vector<pair<Point, Point>> segments;
+    
+    vector<Point> pixels;
+    createAccumulator( src, pixels );
+    if( thresh < 1 )
+        return segments;
+    
+    /* Edge map, where each pixel is either not an edge, an edge that hasn't voted yet, or one that has */
+    enum { NOT_EDGE = 0, EDGE, VOTED_EDGE };
+    Mat mask = Mat::zeros( imageSize, CV_8UC1 );
+    for( const Point& pixel: pixels )
+        mask.at<uchar>( pixel ) = EDGE;
     
-    tbb::parallel_for_each( non_zero_pixels.begin(), non_zero_pixels.end(), [&](Point pixel){
+    /* Shuffle the pixels, that's the order they will vote in */
+    RNG rng( seed );
+    for( int i = static_cast<int>( pixels.size() ) - 1; i > 0; i-- )
+        std::swap( pixels[i], pixels[rng.uniform( 0, i + 1 )] );
+    
+    Mat votes = Mat::zeros( accum.size(), CV_32SC1 );
+    int * votes_ptr = votes.ptr<int>(0);
+    size_t step     = votes.step / sizeof(int);
+    
+    /* Add the given number of votes for every theta of the pixel, returns the theta of its highest bin */
+    auto vote_pixel = [&]( const Point& pixel, int increment, int& max_votes ) {
         float dy = pixel.y - centerY;
         float dx = pixel.x - centerX;
         
+        int max_theta = 0;
+        max_votes = 0;
         for( int theta = 0; theta < thetaMax; theta++ ) {
             float r         = dx * cosines[theta] + dy * sines[theta];
             int rho_index   = rhoRange + r;
+            int& bin        = votes_ptr[rho_index * step + theta];
+            bin += increment;
             
-            /* Increase the accumulator */
-            accum.at<float>(rho_index, theta)++;
+            if( bin > max_votes ) {
+                max_votes = bin;
+                max_theta = theta;
+            }
         }
-    });
+        return max_theta;
+    };
+    
+    const int shift = 16;
+    
+    for( const Point& pixel: pixels ) {
+        /* Might have already been taken by a previous segment */
+        if( mask.at<uchar>( pixel ) != EDGE )
+            continue;
+        
+        mask.at<uchar>( pixel ) = VOTED_EDGE;
+        
+        int max_votes;
+        int theta = vote_pixel( pixel, 1, max_votes );
+        if( max_votes < thresh )
+            continue;
+        
+        /* Walk along the line direction, which is perpendicular to its normal, in fixed point, */
+        /* one pixel at a time along whichever axis the line is closer to */
+        float dir_x = -sines[theta];
+        float dir_y =  cosines[theta];
+        
+        bool x_major = fabs( dir_x ) > fabs( dir_y );
+        int step_x, step_y;
+        if( x_major ) {
+            step_x = dir_x > 0 ? 1 : -1;
+            step_y = cvRound( dir_y * (1 << shift) / fabs( dir_x ) );
+        }
+        else {
+            step_y = dir_y > 0 ? 1 : -1;
+            step_x = cvRound( dir_x * (1 << shift) / fabs( dir_y ) );
+        }
+        
+        auto walk_start = [&]( int& x, int& y ) {
+            x = x_major ? pixel.x : (pixel.x << shift) + (1 << (shift - 1));
+            y = x_major ? (pixel.y << shift) + (1 << (shift - 1)) : pixel.y;
+        };
+        auto walk_point = [&]( int x, int y ) {
+            return x_major ? Point( x, y >> shift ) : Point( x >> shift, y );
+        };
+        
+        /* Find how far the segment goes in both directions */
+        Point ends[2] = { pixel, pixel };
+        for( int k = 0; k < 2; k++ ) {
+            int dx = k == 0 ? step_x : -step_x;
+            int dy = k == 0 ? step_y : -step_y;
+            int gap = 0;
+            
+            int x, y;
+            walk_start( x, y );
+            for( ;; x += dx, y += dy ) {
+                Point point = walk_point( x, y );
+                if( point.x < 0 || point.x >= imageSize.width || point.y < 0 || point.y >= imageSize.height )
+                    break;
+                
+                if( mask.at<uchar>( point ) != NOT_EDGE ) {
+                    gap     = 0;
+                    ends[k] = point;
+                }
+                else if( ++gap > max_gap )
+                    break;
+            }
+        }
+        
+        /* Take the pixels of the segment out of the edge map, along with their votes */
+        for( int k = 0; k < 2; k++ ) {
+            int dx = k == 0 ? step_x : -step_x;
+            int dy = k == 0 ? step_y : -step_y;
+            
+            int x, y;
+            walk_start( x, y );
+            for( ;; x += dx, y += dy ) {
+                Point point = walk_point( x, y );
+                uchar& state = mask.at<uchar>( point );
+                
+                if( state == VOTED_EDGE )
+                    vote_pixel( point, -1, max_votes );
+                state = NOT_EDGE;
+                
+                if( point == ends[k] )
+                    break;
+            }
+        }
+        
+        if( MAX( abs( ends[0].x - ends[1].x ), abs( ends[0].y - ends[1].y ) ) >= min_length )
+            segments.push_back( pair<Point, Point>( ends[0], ends[1] ) );
+    }
+    
+    votes.convertTo( accum, CV_32F );
+    
+    return segments;
 }
 
 /**
@@ -94,41 +379,82 @@ vector<pair<Point, Point>> Hough::getLines( int thresh ) {
     if( thresh < 1 )
         return lines;
     
-    Mat thresholded;
-    accum.copyTo( thresholded, accum >= thresh );
+    for( const HoughLine& peak: findPeaks( thresh ) )
+        lines.push_back( getLine( peak.rhoIndex, peak.theta ) );
+    
+    return lines;
+}
+
+/**
+ * Find the local maxima of the accumulation matrix with at least thresh votes, that are not smaller than
+ * anything within nms_radius bins around them. Theta wraps around, the bin after the last theta is the first theta
+ * with negated rho. Among neighbors with equal votes, only the one with the lowest rho and theta index is kept.
+ * Returns the peaks sorted by their votes, at most max_lines of them if it's positive
+ */
+vector<HoughLine> Hough::findPeaks( float thresh, int max_lines, int nms_radius ) {
+    const int rows = accum.rows;
     
-    /* Pointer to previous, current and next rows */
-    float * prev_row = thresholded.ptr<float>(0),
-          * curr_row = thresholded.ptr<float>(1),
-          * next_row = thresholded.ptr<float>(2);
+    /* A theta shouldn't be its own neighbor after wrapping around */
+    const int rho_radius    = MAX( 0, nms_radius );
+    const int theta_radius  = MIN( rho_radius, (thetaMax - 1) / 2 );
+    
+    /* Bring a bin beyond either end of theta back into the matrix, returns false if it's outside of the matrix */
+    auto wrap_bin = [&]( int& rho_index, int& theta ) {
+        if( theta < 0 || theta >= thetaMax ) {
+            /* Rho bin i holds [i - rhoRange, i - rhoRange + 1), so its negation is bin 2 * rhoRange - 1 - i */
+            theta     = theta < 0 ? theta + thetaMax : theta - thetaMax;
+            rho_index = 2 * rhoRange - 1 - rho_index;
+        }
+        return rho_index >= 0 && rho_index < rows;
+    };
     
-    tbb::concurrent_vector<pair<Point, Point>> c_lines;
+    tbb::enumerable_thread_specific<vector<HoughLine>> local_peaks;
     
-    for( int rho_index = 1; rho_index < thresholded.rows-1; rho_index++ ) {
-        tbb::parallel_for( 1, thetaMax - 1, 1, [&]( int theta ){
-            float max = curr_row[theta];
+    tbb::parallel_for( tbb::blocked_range<int>( 0, rows, 16 ), [&]( const tbb::blocked_range<int>& range ) {
+        vector<HoughLine>& peaks = local_peaks.local();
+        
+        for( int rho_index = range.begin(); rho_index != range.end(); rho_index++ ) {
+            const float * curr_row = accum.ptr<float>(rho_index);
             
-            if( max != 0 ) {
-                /* Are there any higher peaks in 3x3 region ? */
-                for (int x = -1; x < 2; x++ ) {
-                    max = MAX( max, prev_row[x] );
-                    max = MAX( max, curr_row[x] );
-                    max = MAX( max, next_row[x] );
+            for( int theta = 0; theta < thetaMax; theta++ ) {
+                const float votes = curr_row[theta];
+                if( votes < thresh || votes <= 0 )
+                    continue;
+                
+                bool is_peak = true;
+                for( int dr = -rho_radius; dr <= rho_radius && is_peak; dr++ ) {
+                    for( int dt = -theta_radius; dt <= theta_radius; dt++ ) {
+                        if( dr == 0 && dt == 0 )
+                            continue;
+                        
+                        int neighbor_rho    = rho_index + dr;
+                        int neighbor_theta  = theta + dt;
+                        if( !wrap_bin( neighbor_rho, neighbor_theta ) )
+                            continue;
+                        
+                        /* Ties go to whichever bin comes first in the matrix */
+                        float neighbor = accum.ptr<float>(neighbor_rho)[neighbor_theta];
+                        bool is_before = neighbor_rho < rho_index || (neighbor_rho == rho_index && neighbor_theta < theta);
+                        if( neighbor > votes || (neighbor == votes && is_before) ) {
+                            is_peak = false;
+                            break;
+                        }
+                    }
                 }
                 
-                /* Only process if it's local maxima */
-                if( max == curr_row[theta])
-                    c_lines.push_back( getLine( rho_index, theta ) );
+                if( is_peak )
+                    peaks.push_back( HoughLine( rho_index, theta, votes ) );
             }
-        });
-        
-        /* Move each pointer to the next row */
-        prev_row = curr_row;
-        curr_row = next_row;
-        next_row = thresholded.ptr<float>( rho_index + 1 );
-    }
+        }
+    });
     
-    std::copy( c_lines.begin(), c_lines.end(), back_inserter(lines ));
+    vector<HoughLine> peaks;
+    for( const vector<HoughLine>& local: local_peaks )
+        peaks.insert( peaks.end(), local.begin(), local.end() );
     
-    return lines;
-}
\ No newline at end of file
+    sortPeaks( peaks, max_lines, []( const HoughLine& a, const HoughLine& b ) {
+        return a.rhoIndex != b.rhoIndex ? a.rhoIndex < b.rhoIndex : a.theta < b.theta;
+    });
+    
+    return peaks;
+}
@@ -11,26 +11,69 @@
 
 #include <iostream>
 #include <opencv2/opencv.hpp>
+#include <tbb/cache_aligned_allocator.h>
 
 using namespace std;
 using namespace cv;
 
+/**
+ * A line found in the accumulation matrix, with the number of votes it got
+ */
+struct HoughLine {
+    int rhoIndex;
+    int theta;
+    float votes;
+    
+    HoughLine( int rho_index, int theta, float votes ) : rhoIndex( rho_index ), theta( theta ), votes( votes ) {}
+};
+
+/**
+ * Sort the peaks by their votes, strongest first, with the ties in the order given by comes_before,
+ * so that the result doesn't depend on the order the threads found them. Keeps at most max_peaks of them if it's positive
+ */
+template <typename Peak, typename BinOrder>
+void sortPeaks( vector<Peak>& peaks, int max_peaks, BinOrder comes_before ) {
+    auto is_stronger = [&]( const Peak& a, const Peak& b ) {
+        return a.votes != b.votes ? a.votes > b.votes : comes_before( a, b );
+    };
+    
+    if( max_peaks > 0 && max_peaks < static_cast<int>( peaks.size() ) ) {
+        std::partial_sort( peaks.begin(), peaks.begin() + max_peaks, peaks.end(), is_stronger );
+        peaks.erase( peaks.begin() + max_peaks, peaks.end() );
+    }
+    else
+        std::sort( peaks.begin(), peaks.end(), is_stronger );
+}
+
 class Hough {
 public:
-    Hough();
+    Hough( int theta_max = 180 );
     ~Hough();
     void init( Mat& src );
+    void initGradient( Mat& src, Mat& grad_x, Mat& grad_y, int theta_window = 4, bool weighted = false );
     vector<pair<Point, Point>> getLines( int thresh );
+    vector<HoughLine> findPeaks( float thresh, int max_lines = 0, int nms_radius = 1 );
+    vector<pair<Point, Point>> detectSegments( Mat& src, int thresh, int min_length = 30, int max_gap = 10, uint64 seed = 0xffffffff );
     pair<Point, Point> getLine( int rho_index, int theta );
     Mat getAccumulationMatrix( float thresh = 0.0 );
     
 protected:
+    void createAccumulator( Mat& src, vector<Point>& pixels );
+    void vote( const vector<Point>& pixels );
+    
+    template <typename PixelVoter>
+    void accumulate( size_t no_of_pixels, PixelVoter vote_pixel );
+    
     float centerX, centerY;
     int rhoRange;
     Size imageSize;
     Mat accum;
-    const int thetaMax = 90 * 2;
-    vector<float> cosines, sines;
+    
+    /* Number of theta bins spanning 180 degrees */
+    int thetaMax;
+    
+    /* Cache line aligned, so that the voting can load several of them at once */
+    vector<float, tbb::cache_aligned_allocator<float>> cosines, sines;
 };
 
 #endif /* defined(__TestHough__Hough__) */
@@ -12,6 +12,7 @@
 
 
 #include "Hough.h"
+#include "CircleHough.h"
 
 using namespace cv;
 using namespace std;
@@ -32,11 +33,19 @@ int main(int argc, const char * argv[]) {
     cvtColor( image, gray, CV_BGR2GRAY );
     Canny( gray, edges, 100, 300, 3 );
     
+    /* Image gradients, for the gradient directed voting */
+    Mat grad_x, grad_y;
+    Sobel( gray, grad_x, CV_32F, 1, 0 );
+    Sobel( gray, grad_y, CV_32F, 0, 1 );
+    
     
     /* Initialize the Hough accumulation matrix */
     Hough hough;
     hough.init( edges );
     
+    /* Keep the single channel edges around, to re-initialize the accumulation matrix */
+    Mat canny_edges = edges.clone();
+    
     
     /* Make the Canny edges, blue, real blue */
     vector<Mat> temp = {
@@ -59,8 +68,26 @@ int main(int argc, const char * argv[]) {
     
     
     bool show_canny = false;
+    bool gradient_mode = false;
+    bool probabilistic_mode = false;
+    bool show_circles = false;
+    bool show_ellipses = false;
     int threshold = 0;
     createTrackbar( "Hough threshold", "", &threshold, 1000 );
+    int circle_threshold = 80;
+    createTrackbar( "Circle threshold", "", &circle_threshold, 1000 );
+    
+    /* The segments are only detected again when the threshold changes, on their own accumulation matrix */
+    Hough segment_hough;
+    vector<pair<Point, Point>> segments;
+    int segment_threshold = -1;
+    
+    /* Same for the circles and ellipses, which are only detected while they're shown */
+    CircleHough circle_hough;
+    vector<HoughCircle> circles;
+    vector<HoughEllipse> ellipses;
+    int circles_threshold = -1, ellipses_threshold = -1;
+    const int max_radius = MIN( image.cols, image.rows ) / 2;
     
     /* Stuff for drawing text */
     CvFont font = cvFontQt("Helvetica", 14.0, CV_RGB(0, 255, 0) );
@@ -80,12 +107,45 @@ int main(int argc, const char * argv[]) {
         applyColorMap( accum, accum, cv::COLORMAP_JET );
         resize( accum, accum, Size(), 2.0, 0.5 );
         
-        /* Draw the lines based on threshold */
-        vector<pair<Point, Point>> lines = hough.getLines( threshold );
-        for( pair<Point, Point> point_pair : lines )
-            line( temp, point_pair.first, point_pair.second, CV_RGB(255, 0, 0), 1 );
+        /* Draw the lines, or the line segments, based on threshold */
+        if( probabilistic_mode ) {
+            if( segment_threshold != threshold ) {
+                segments = segment_hough.detectSegments( canny_edges, threshold );
+                segment_threshold = threshold;
+            }
+            
+            for( pair<Point, Point> point_pair : segments )
+                line( temp, point_pair.first, point_pair.second, CV_RGB(255, 0, 0), 2 );
+        }
+        else {
+            vector<pair<Point, Point>> lines = hough.getLines( threshold );
+            for( pair<Point, Point> point_pair : lines )
+                line( temp, point_pair.first, point_pair.second, CV_RGB(255, 0, 0), 1 );
+        }
     
         
+        /* Draw the circles and ellipses */
+        if( show_circles ) {
+            if( circles_threshold != circle_threshold ) {
+                circles = circle_hough.findCircles( canny_edges, grad_x, grad_y, 10, max_radius, MAX( 1, circle_threshold ), 20 );
+                circles_threshold = circle_threshold;
+            }
+            
+            for( HoughCircle& circle_found : circles )
+                circle( temp, circle_found.center, cvRound( circle_found.radius ), CV_RGB(255, 255, 0), 2 );
+        }
+        
+        if( show_ellipses ) {
+            if( ellipses_threshold != circle_threshold ) {
+                ellipses = circle_hough.findEllipses( canny_edges, grad_x, grad_y, 10, max_radius, MAX( 1, circle_threshold ), 20 );
+                ellipses_threshold = circle_threshold;
+            }
+            
+            for( HoughEllipse& ellipse_found : ellipses )
+                ellipse( temp, ellipse_found.box, CV_RGB(255, 0, 255), 2 );
+        }
+        
+        
         /* Draw lines based on cursor position */
         if(accumIndex.x != -1 && accumIndex.y != -1 ) {
             pair<Point, Point> point_pair = hough.getLine( accumIndex.y, accumIndex.x );
@@ -102,11 +162,14 @@ int main(int argc, const char * argv[]) {
         /* Output some text */
         addText( appended, "Accum matrix", Point( temp.cols + 10, 15 ), font );
         addText( appended, "[C] to show Canny edges", Point( 10, image.rows + 15 ), font );
-        addText( appended, "[Q] to quit", Point( 10, image.rows + 30 ), font );
+        addText( appended, "[G] to toggle gradient directed voting", Point( 10, image.rows + 30 ), font );
+        addText( appended, "[P] to toggle probabilistic line segments", Point( 10, image.rows + 45 ), font );
+        addText( appended, "[O] to show circles, [E] to show ellipses", Point( 10, image.rows + 60 ), font );
+        addText( appended, "[Q] to quit", Point( 10, image.rows + 75 ), font );
         sprintf( str, "Threshold: %d", threshold );
-        addText( appended, str, Point( 10, image.rows + 45 ), font );
+        addText( appended, str, Point( 10, image.rows + 90 ), font );
         sprintf( str, "Rho: %d   Theta: %d", accumIndex.y - accum.rows / 2, accumIndex.x );
-        addText( appended, str, Point( 10, image.rows + 60 ), font );
+        addText( appended, str, Point( 10, image.rows + 105 ), font );
 
         
         imshow( "", appended );
@@ -115,6 +178,23 @@ int main(int argc, const char * argv[]) {
             break;
         else if( key == 'c' )
             show_canny = !show_canny;
+        else if( key == 'g' ) {
+            gradient_mode = !gradient_mode;
+            if( gradient_mode )
+                hough.initGradient( canny_edges, grad_x, grad_y );
+            else
+                hough.init( canny_edges );
+        }
+        else if( key == 'p' )
+            probabilistic_mode = !probabilistic_mode;
+        else if( key == 'o' ) {
+            show_circles = !show_circles;
+            circles_threshold = -1;
+        }
+        else if( key == 'e' ) {
+            show_ellipses = !show_ellipses;
+            ellipses_threshold = -1;
+        }
     }
     
     return 0;
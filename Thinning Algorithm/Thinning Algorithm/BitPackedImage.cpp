@@ -0,0 +1,72 @@
+//
+//  BitPackedImage.cpp
+//  Thinning Algorithm
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#include "BitPackedImage.h"
+
+using namespace std;
+using namespace cv;
+
+BitPackedImage::BitPackedImage()
+: rows( 0 ), cols( 0 ), wordsPerRow( 0 ) {
+}
+
+BitPackedImage::BitPackedImage( int rows, int cols )
+: rows( rows ),
+  cols( cols ),
+  wordsPerRow( (cols + 63) / 64 + 2 ),
+  words( rows * wordsPerRow, 0 ) {
+}
+
+/**
+ * Pack a single channel 8 bit image, a pixel is set when it's above thresh, or at most thresh when inverse is set,
+ * the same way as cv::threshold with CV_THRESH_BINARY or CV_THRESH_BINARY_INV. By default any non zero pixel is set
+ */
+BitPackedImage BitPackedImage::pack( const Mat& gray, uchar thresh, bool inverse ) {
+    CV_Assert( gray.type() == CV_8UC1 );
+    
+    BitPackedImage packed( gray.rows, gray.cols );
+    for( int y = 0; y < gray.rows; y++ )
+        packed.packRow( y, gray.ptr<uchar>(y), thresh, inverse );
+    return packed;
+}
+
+/**
+ * Unpack back into a CV_8UC1 image of 0 and 1s
+ */
+Mat BitPackedImage::unpack() const {
+    Mat binary( rows, cols, CV_8UC1 );
+    for( int y = 0; y < rows; y++ )
+        unpackRow( y, binary.ptr<uchar>(y) );
+    return binary;
+}
+
+/**
+ * Pack a row of cols pixels into row y, overwriting it, thresholded the same way as pack()
+ */
+void BitPackedImage::packRow( int y, const uchar * src, uchar thresh, bool inverse ) {
+    uint64_t * dst = ptr(y);
+    
+    for( int word = 0; word * 64 < cols; word++ ) {
+        const int x_start = word * 64;
+        const int x_end   = MIN( x_start + 64, cols );
+        
+        uint64_t bits = 0;
+        for( int x = x_start; x < x_end; x++ )
+            bits |= uint64_t( (src[x] > thresh) != inverse ) << (x - x_start);
+        dst[word] = bits;
+    }
+}
+
+/**
+ * Unpack row y into cols pixels of 0 and 1s
+ */
+void BitPackedImage::unpackRow( int y, uchar * dst ) const {
+    const uint64_t * src = ptr(y);
+    for( int x = 0; x < cols; x++ )
+        dst[x] = (src[x >> 6] >> (x & 63)) & 1;
+}
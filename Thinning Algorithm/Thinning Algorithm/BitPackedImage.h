@@ -0,0 +1,52 @@
+//
+//  BitPackedImage.h
+//  Thinning Algorithm
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __Thinning_Algorithm__BitPackedImage__
+#define __Thinning_Algorithm__BitPackedImage__
+
+#include <iostream>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+/**
+ * Binary image with 64 pixels packed into each word, 8 times smaller than a CV_8UC1 Mat.
+ * Pixel x of a row is bit (x % 64) of word 1 + x / 64, the first and last word of each row are
+ * always zero, so that shifting a word to its neighboring columns never needs a boundary check.
+ * Bits past the last column are zero as well.
+ *
+ * Images that are too large to keep as bytes can be filled and read back one row at a time,
+ * with packRow() and unpackRow(), or by writing the words of ptr(y) directly
+ */
+class BitPackedImage {
+public:
+    BitPackedImage();
+    BitPackedImage( int rows, int cols );
+    
+    static BitPackedImage pack( const cv::Mat& gray, uchar thresh = 0, bool inverse = false );
+    cv::Mat unpack() const;
+    
+    void packRow( int y, const uchar * src, uchar thresh = 0, bool inverse = false );
+    void unpackRow( int y, uchar * dst ) const;
+    
+    inline uint64_t * ptr( int y ) {
+        return &words[y * wordsPerRow + 1];
+    }
+    
+    inline const uint64_t * ptr( int y ) const {
+        return &words[y * wordsPerRow + 1];
+    }
+    
+    int rows;
+    int cols;
+    
+    /* Number of words in each row, including the 2 padding words */
+    int wordsPerRow;
+    std::vector<uint64_t> words;
+};
+
+#endif /* defined(__Thinning_Algorithm__BitPackedImage__) */
@@ -0,0 +1,53 @@
+//
+//  GuoHallThinning.cpp
+//  Thinning Algorithm
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#include "GuoHallThinning.h"
+
+using namespace std;
+using namespace cv;
+
+int GuoHallThinning::thinBinary( Mat& binary ) {
+    return thinLookupTables( binary, getLookupTable( 0 ), getLookupTable( 1 ) );
+}
+
+string GuoHallThinning::getName() {
+    return "Guo-Hall";
+}
+
+/**
+ * Lookup tables for both subiterations, indexed by the packed neighborhood from getNeighborhoodIndex().
+ * An entry is 1 if P1 should be removed given that neighborhood
+ */
+const uchar * GuoHallThinning::getLookupTable( int subiteration ) {
+    struct LookupTables {
+        uchar tables[2][256];
+        
+        LookupTables() {
+            for( int index = 0; index < 256; index++ ) {
+                /* P2 to P9 */
+                int p2 = (index >> 0) & 1, p3 = (index >> 1) & 1, p4 = (index >> 2) & 1, p5 = (index >> 3) & 1,
+                    p6 = (index >> 4) & 1, p7 = (index >> 5) & 1, p8 = (index >> 6) & 1, p9 = (index >> 7) & 1;
+                
+                /* Number of distinct 8-connected components around P1 */
+                int c  = (!p2 && (p3 || p4)) + (!p4 && (p5 || p6)) + (!p6 && (p7 || p8)) + (!p8 && (p9 || p2));
+                
+                int n1 = (p9 || p2) + (p3 || p4) + (p5 || p6) + (p7 || p8);
+                int n2 = (p2 || p3) + (p4 || p5) + (p6 || p7) + (p8 || p9);
+                int n  = MIN( n1, n2 );
+                
+                bool removable = c == 1 && n >= 2 && n <= 3;
+                
+                tables[0][index] = removable && !((p6 || p7 || !p9) && p8);
+                tables[1][index] = removable && !((p2 || p3 || !p5) && p4);
+            }
+        }
+    };
+    
+    static const LookupTables lookup_tables;
+    return lookup_tables.tables[subiteration];
+}
@@ -0,0 +1,32 @@
+//
+//  GuoHallThinning.h
+//  Thinning Algorithm
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __Thinning_Algorithm__GuoHallThinning__
+#define __Thinning_Algorithm__GuoHallThinning__
+
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "Thinning.h"
+
+/**
+ * An implementation of Guo-Hall's thinning algorithm
+ * "Parallel thinning with two-subiteration algorithms", Z. Guo and R. W. Hall, 1989
+ *
+ * Like Zhang-Suen it removes pixels in two subiterations, but it preserves diagonal lines better
+ * and tends to produce thinner skeletons. Uses the same lookup table kernel as ZhangSuenThinning
+ */
+class GuoHallThinning : public Thinning {
+public:
+    std::string getName();
+    
+protected:
+    int thinBinary( cv::Mat& binary );
+    static const uchar * getLookupTable( int subiteration );
+};
+
+#endif /* defined(__Thinning_Algorithm__GuoHallThinning__) */
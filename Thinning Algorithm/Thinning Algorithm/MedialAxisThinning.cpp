@@ -0,0 +1,43 @@
+//
+//  MedialAxisThinning.cpp
+//  Thinning Algorithm
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#include "MedialAxisThinning.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Keep only the local maxima of the distance transform, returns 1 since it's done in a single pass
+ */
+int MedialAxisThinning::thinBinary( Mat& binary ) {
+    Mat distances;
+    distanceTransform( binary, distances, CV_DIST_L1, 3 );
+    
+    for( int y = 0; y < binary.rows; y++ ) {
+        const float * prev_dist = distances.ptr<float>( MAX(y - 1, 0) );
+        const float * curr_dist = distances.ptr<float>( y );
+        const float * next_dist = distances.ptr<float>( MIN(y + 1, binary.rows - 1) );
+        uchar * ptr = binary.ptr<uchar>(y);
+        
+        for( int x = 0; x < binary.cols; x++ ) {
+            if( !ptr[x] )
+                continue;
+            
+            const float dist = curr_dist[x];
+            if( prev_dist[x] > dist || next_dist[x] > dist ||
+               (x > 0 && curr_dist[x-1] > dist) || (x < binary.cols - 1 && curr_dist[x+1] > dist) )
+                ptr[x] = 0;
+        }
+    }
+    
+    return 1;
+}
+
+string MedialAxisThinning::getName() {
+    return "Medial axis";
+}
@@ -0,0 +1,30 @@
+//
+//  MedialAxisThinning.h
+//  Thinning Algorithm
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __Thinning_Algorithm__MedialAxisThinning__
+#define __Thinning_Algorithm__MedialAxisThinning__
+
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "Thinning.h"
+
+/**
+ * Medial axis from the city block distance transform, the skeleton is made of the centers of the
+ * maximal disks, i.e. the pixels whose distance isn't exceeded by any of their 4 neighbors
+ * (Rosenfeld and Pfaltz). It's not iterative, but unlike the other thinning algorithms the skeleton
+ * isn't guaranteed to be connected nor 1 pixel wide
+ */
+class MedialAxisThinning : public Thinning {
+public:
+    std::string getName();
+    
+protected:
+    int thinBinary( cv::Mat& binary );
+};
+
+#endif /* defined(__Thinning_Algorithm__MedialAxisThinning__) */
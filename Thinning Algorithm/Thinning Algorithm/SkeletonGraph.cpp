@@ -0,0 +1,278 @@
+//
+//  SkeletonGraph.cpp
+//  Thinning Algorithm
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#include "SkeletonGraph.h"
+#include "Thinning.h"
+
+using namespace std;
+using namespace cv;
+
+SkeletonGraph::SkeletonGraph() {
+}
+
+SkeletonGraph::SkeletonGraph( const Mat& skeleton ) {
+    build( skeleton );
+}
+
+/**
+ * Build the graph from a thinned image, any non zero pixel is part of the skeleton
+ */
+void SkeletonGraph::build( const Mat& skeleton ) {
+    CV_Assert( skeleton.type() == CV_8UC1 );
+    
+    nodePoints.clear();
+    nodeTypes.clear();
+    edgeStart.clear();
+    edgeEnd.clear();
+    edgeOffsets.assign( 1, 0 );
+    edgePoints.clear();
+    directLinks.clear();
+    
+    padded = Mat::zeros( skeleton.rows + 2, skeleton.cols + 2, CV_8UC1 );
+    for( int y = 0; y < skeleton.rows; y++ ) {
+        const uchar * src = skeleton.ptr<uchar>(y);
+        uchar * dst       = padded.ptr<uchar>(y + 1) + 1;
+        for( int x = 0; x < skeleton.cols; x++ )
+            dst[x] = src[x] != 0;
+    }
+    
+    nodeIDs = Mat( padded.size(), CV_32SC1, Scalar(-1) );
+    visited = Mat::zeros( padded.size(), CV_8UC1 );
+    
+    /* 4 neighbors first, so that the corners of a staircase aren't skipped while tracing */
+    const int stride   = padded.cols;
+    neighborOffsets[0] = -stride;
+    neighborOffsets[1] = 1;
+    neighborOffsets[2] = stride;
+    neighborOffsets[3] = -1;
+    neighborOffsets[4] = -stride + 1;
+    neighborOffsets[5] = stride + 1;
+    neighborOffsets[6] = stride - 1;
+    neighborOffsets[7] = -stride - 1;
+    
+    /* Classify every skeleton pixel from its neighborhood */
+    const uchar * node_table = getNodeTable();
+    Mat types( padded.size(), CV_8UC1, Scalar(NOT_A_NODE) );
+    for( int y = 1; y < padded.rows - 1; y++ ) {
+        const uchar * row1 = padded.ptr<uchar>(y - 1);
+        const uchar * row2 = padded.ptr<uchar>(y    );
+        const uchar * row3 = padded.ptr<uchar>(y + 1);
+        uchar * type_ptr   = types.ptr<uchar>(y);
+        
+        for( int x = 1; x < padded.cols - 1; x++ ) {
+            if( row2[x] )
+                type_ptr[x] = node_table[Thinning::getNeighborhoodIndex( row1, row2, row3, x )];
+        }
+    }
+    
+    /* Create the nodes, adjacent junction pixels are flood filled into the same node */
+    const uchar * type_data = types.data;
+    int * node_ids          = nodeIDs.ptr<int>();
+    const int total         = static_cast<int>( padded.total() );
+    vector<int> stack;
+    
+    for( int offset = 0; offset < total; offset++ ) {
+        if( type_data[offset] == NOT_A_NODE || node_ids[offset] >= 0 )
+            continue;
+        
+        int node = addNode( offset, static_cast<NodeType>( type_data[offset] ) );
+        if( type_data[offset] != JUNCTION )
+            continue;
+        
+        stack.push_back( offset );
+        while( !stack.empty() ) {
+            int current = stack.back();
+            stack.pop_back();
+            
+            for( int neighbor_offset: neighborOffsets ) {
+                int neighbor = current + neighbor_offset;
+                if( type_data[neighbor] == JUNCTION && node_ids[neighbor] < 0 ) {
+                    node_ids[neighbor] = node;
+                    stack.push_back( neighbor );
+                }
+            }
+        }
+    }
+    
+    /* Trace the edges from every node pixel */
+    for( int offset = 0; offset < total; offset++ ) {
+        if( node_ids[offset] >= 0 )
+            traceEdges( offset );
+    }
+    
+    /* What's left are closed loops without any node */
+    const uchar * padded_data = padded.data;
+    const uchar * visited_data = visited.data;
+    for( int offset = 0; offset < total; offset++ ) {
+        if( padded_data[offset] && !visited_data[offset] && node_ids[offset] < 0 ) {
+            addNode( offset, LOOP_POINT );
+            traceEdges( offset );
+        }
+    }
+    
+    padded.release();
+    nodeIDs.release();
+    visited.release();
+    directLinks.clear();
+}
+
+int SkeletonGraph::getNodesCount() {
+    return static_cast<int>( nodePoints.size() );
+}
+
+int SkeletonGraph::getEdgesCount() {
+    return static_cast<int>( edgeStart.size() );
+}
+
+/**
+ * Node type of a skeleton pixel, indexed by its packed neighborhood. The number of branches around the pixel
+ * is the number of 01 patterns in P2, P3, ..., P9, P2. One branch is an end point, two is just a point along an edge
+ */
+const uchar * SkeletonGraph::getNodeTable() {
+    struct NodeTable {
+        uchar table[256];
+        
+        NodeTable() {
+            for( int index = 0; index < 256; index++ ) {
+                int non_zeros = 0, transitions = 0;
+                for( int i = 0; i < 8; i++ ) {
+                    int p      = (index >> i) & 1;
+                    int p_next = (index >> ((i + 1) & 7)) & 1;
+                    non_zeros   += p;
+                    transitions += !p && p_next;
+                }
+                
+                if( non_zeros == 0 )
+                    table[index] = ISOLATED_POINT;
+                else if( transitions == 1 )
+                    table[index] = END_POINT;
+                else if( transitions == 2 )
+                    table[index] = NOT_A_NODE;
+                else
+                    table[index] = JUNCTION;
+            }
+        }
+    };
+    
+    static const NodeTable node_table;
+    return node_table.table;
+}
+
+int SkeletonGraph::addNode( int offset, NodeType type ) {
+    int node = static_cast<int>( nodePoints.size() );
+    nodePoints.push_back( Point( offset % padded.cols - 1, offset / padded.cols - 1 ) );
+    nodeTypes.push_back( type );
+    nodeIDs.ptr<int>()[offset] = node;
+    return node;
+}
+
+/**
+ * Trace every edge leaving the given node pixel that hasn't been traced yet
+ */
+void SkeletonGraph::traceEdges( int offset ) {
+    const uchar * padded_data = padded.data;
+    const int * node_ids      = nodeIDs.ptr<int>();
+    const int node            = node_ids[offset];
+    
+    for( int neighbor_offset: neighborOffsets ) {
+        const int neighbor = offset + neighbor_offset;
+        if( !padded_data[neighbor] )
+            continue;
+        
+        const int neighbor_node = node_ids[neighbor];
+        if( neighbor_node < 0 ) {
+            if( !visited.data[neighbor] )
+                traceEdge( node, offset, neighbor );
+        }
+        /* Two different nodes touching each other directly, only link them once, from the smaller node */
+        else if( node < neighbor_node ) {
+            if( directLinks.insert( make_pair( node, neighbor_node ) ).second ) {
+                edgePoints.push_back( Point( offset % padded.cols - 1, offset / padded.cols - 1 ) );
+                edgePoints.push_back( Point( neighbor % padded.cols - 1, neighbor / padded.cols - 1 ) );
+                edgeStart.push_back( node );
+                edgeEnd.push_back( neighbor_node );
+                edgeOffsets.push_back( static_cast<int>( edgePoints.size() ) );
+            }
+        }
+    }
+}
+
+/**
+ * Walk along the edge that starts from the node pixel at offset towards next_offset, until it reaches a node.
+ * If the edge stops without reaching any node, its last pixel becomes a new end point. Returns the end node
+ */
+int SkeletonGraph::traceEdge( int node, int offset, int next_offset ) {
+    const uchar * padded_data = padded.data;
+    const int * node_ids      = nodeIDs.ptr<int>();
+    uchar * visited_data      = visited.data;
+    const int stride          = padded.cols;
+    
+    edgePoints.push_back( Point( offset % stride - 1, offset / stride - 1 ) );
+    
+    int previous  = offset;
+    int current   = next_offset;
+    int length    = 1;
+    int end_node  = -1;
+    
+    while( true ) {
+        visited_data[current] = 1;
+        edgePoints.push_back( Point( current % stride - 1, current / stride - 1 ) );
+        
+        /* Reaching any node ends the edge, except going right back into the node it started from */
+        int next = -1;
+        for( int neighbor_offset: neighborOffsets ) {
+            const int neighbor = current + neighbor_offset;
+            if( neighbor != previous && padded_data[neighbor] && node_ids[neighbor] >= 0 && (node_ids[neighbor] != node || length >= 2) ) {
+                next     = neighbor;
+                end_node = node_ids[neighbor];
+                break;
+            }
+        }
+        
+        if( end_node >= 0 ) {
+            edgePoints.push_back( Point( next % stride - 1, next / stride - 1 ) );
+            break;
+        }
+        
+        for( int neighbor_offset: neighborOffsets ) {
+            const int neighbor = current + neighbor_offset;
+            if( padded_data[neighbor] && node_ids[neighbor] < 0 && !visited_data[neighbor] ) {
+                next = neighbor;
+                break;
+            }
+        }
+        
+        /* Nowhere else to go, so it's a small loop back into the node it started from */
+        if( next < 0 ) {
+            for( int neighbor_offset: neighborOffsets ) {
+                const int neighbor = current + neighbor_offset;
+                if( neighbor != previous && padded_data[neighbor] && node_ids[neighbor] == node ) {
+                    edgePoints.push_back( Point( neighbor % stride - 1, neighbor / stride - 1 ) );
+                    end_node = node;
+                    break;
+                }
+            }
+            if( end_node >= 0 )
+                break;
+        }
+        
+        if( next < 0 ) {
+            end_node = addNode( current, END_POINT );
+            break;
+        }
+        
+        previous = current;
+        current  = next;
+        length++;
+    }
+    
+    edgeStart.push_back( node );
+    edgeEnd.push_back( end_node );
+    edgeOffsets.push_back( static_cast<int>( edgePoints.size() ) );
+    return end_node;
+}
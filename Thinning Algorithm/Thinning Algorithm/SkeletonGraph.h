@@ -0,0 +1,74 @@
+//
+//  SkeletonGraph.h
+//  Thinning Algorithm
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __Thinning_Algorithm__SkeletonGraph__
+#define __Thinning_Algorithm__SkeletonGraph__
+
+#include <iostream>
+#include <set>
+#include <opencv2/opencv.hpp>
+
+/**
+ * Graph of a thinned skeleton, made of junctions, end points, and the polylines between them.
+ *
+ * Each skeleton pixel is classified from its packed 8 neighborhood (see Thinning::getNeighborhoodIndex())
+ * with a lookup table, by the number of branches around it. Adjacent junction pixels are merged into a single node.
+ * The edges are then traced from every node in a single pass, with a visited bitmap so that each pixel is walked
+ * only once. Closed loops without any node get a LOOP_POINT node at their first pixel.
+ *
+ * Everything is stored in flat arrays, the polyline of edge i is
+ * edgePoints[edgeOffsets[i]] ... edgePoints[edgeOffsets[i + 1] - 1], starting at a pixel of node edgeStart[i]
+ * and ending at a pixel of node edgeEnd[i]
+ */
+class SkeletonGraph {
+public:
+    enum NodeType {
+        END_POINT,
+        JUNCTION,
+        ISOLATED_POINT,
+        LOOP_POINT,
+    };
+    
+    SkeletonGraph();
+    SkeletonGraph( const cv::Mat& skeleton );
+    
+    void build( const cv::Mat& skeleton );
+    
+    int getNodesCount();
+    int getEdgesCount();
+    
+    /* Nodes, the point is the first pixel of the node in raster order */
+    std::vector<cv::Point> nodePoints;
+    std::vector<uchar> nodeTypes;
+    
+    /* Edges */
+    std::vector<int> edgeStart;
+    std::vector<int> edgeEnd;
+    std::vector<int> edgeOffsets;
+    std::vector<cv::Point> edgePoints;
+    
+protected:
+    static const uchar * getNodeTable();
+    int addNode( int offset, NodeType type );
+    void traceEdges( int offset );
+    int traceEdge( int node, int offset, int next_offset );
+    
+private:
+    enum { NOT_A_NODE = 255 };
+    
+    /* Skeleton padded with 1 pixel of zeros, so that every pixel has all its 8 neighbors */
+    cv::Mat padded;
+    cv::Mat nodeIDs;
+    cv::Mat visited;
+    int neighborOffsets[8];
+    
+    /* Pairs of nodes that touch each other directly, and are already linked by an edge */
+    std::set<std::pair<int, int>> directLinks;
+};
+
+#endif /* defined(__Thinning_Algorithm__SkeletonGraph__) */
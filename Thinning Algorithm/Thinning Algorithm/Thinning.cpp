@@ -0,0 +1,278 @@
+//
+//  Thinning.cpp
+//  Thinning Algorithm
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#include "Thinning.h"
+#include <cfloat>
+
+using namespace std;
+using namespace cv;
+
+Thinning::Thinning()
+: binarizer( otsuBinarization ),
+  pruneLength( 0 ),
+  iterations( 0 ) {
+}
+
+Thinning::~Thinning() {
+}
+
+/**
+ * Binarize and skeletonize the image, then prune the spurs if a prune length is set
+ */
+Mat Thinning::thin( const Mat& image ) {
+    Mat binary;
+    if( binarizer )
+        binary = binarizer( image );
+    else {
+        CV_Assert( image.type() == CV_8UC1 );
+        threshold( image, binary, 0, 1, CV_THRESH_BINARY );
+    }
+    
+    iterations = thinBinary( binary );
+    
+    if( pruneLength > 0 )
+        pruneSpurs( binary, pruneLength );
+    
+    return binary;
+}
+
+void Thinning::setBinarizer( Binarizer binarizer ) {
+    this->binarizer = binarizer;
+}
+
+/**
+ * The input of thin() is already binary, any non zero pixel is treated as foreground
+ */
+void Thinning::skipBinarization() {
+    binarizer = nullptr;
+}
+
+/**
+ * Branches that are at most prune_length pixels long from an end point to a junction are removed, 0 disables pruning
+ */
+void Thinning::setPruneLength( int prune_length ) {
+    pruneLength = prune_length;
+}
+
+/**
+ * Number of iterations used by the last call to thin()
+ */
+int Thinning::getIterations() {
+    return iterations;
+}
+
+/**
+ * Convert the image into grayscale and threshold it using Otsu's algorithm, so that the end matrix is just 0 and 1s
+ */
+Mat Thinning::otsuBinarization( const Mat& image ) {
+    Mat gray;
+    if( image.channels() == 1 )
+        gray = image.clone();
+    else
+        cvtColor( image, gray, CV_BGR2GRAY );
+    
+    threshold( gray, gray, 0, 1, CV_THRESH_OTSU | CV_THRESH_BINARY_INV );
+    return gray;
+}
+
+/**
+ * Otsu's threshold of the grayscale of the image, the same one that otsuBinarization() picks. It's computed
+ * from a histogram that is filled row by row, so no grayscale copy of the whole image is made
+ */
+uchar Thinning::otsuThreshold( const Mat& image ) {
+    const int no_of_bins = 256;
+    vector<int> histogram( no_of_bins, 0 );
+    
+    Mat buffer;
+    for( int y = 0; y < image.rows; y++ ) {
+        const uchar * row = grayscaleRow( image, y, buffer );
+        for( int x = 0; x < image.cols; x++ )
+            histogram[row[x]]++;
+    }
+    
+    /* Pick the threshold that maximizes the between class variance, this follows cv::threshold's own */
+    /* implementation step by step, so that both agree even when the variances tie */
+    const double scale = 1.0 / (double( image.rows ) * image.cols);
+    double mu = 0.0;
+    for( int i = 0; i < no_of_bins; i++ )
+        mu += i * histogram[i] * scale;
+    
+    double mu1 = 0.0, q1 = 0.0, max_sigma = 0.0;
+    int max_val = 0;
+    for( int i = 0; i < no_of_bins; i++ ) {
+        const double p_i = histogram[i] * scale;
+        mu1 *= q1;
+        q1  += p_i;
+        
+        const double q2 = 1.0 - q1;
+        if( MIN( q1, q2 ) < FLT_EPSILON || MAX( q1, q2 ) > 1.0 - FLT_EPSILON )
+            continue;
+        
+        mu1 = (mu1 + i * p_i) / q1;
+        const double mu2   = (mu - q1 * mu1) / q2;
+        const double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+        if( sigma > max_sigma ) {
+            max_sigma = sigma;
+            max_val   = i;
+        }
+    }
+    return static_cast<uchar>( max_val );
+}
+
+/**
+ * Row y of the image in grayscale, color images are converted one row at a time into the buffer
+ */
+const uchar * Thinning::grayscaleRow( const Mat& image, int y, Mat& buffer ) {
+    if( image.channels() == 1 )
+        return image.ptr<uchar>(y);
+    
+    cvtColor( image.row( y ), buffer, CV_BGR2GRAY );
+    return buffer.ptr<uchar>(0);
+}
+
+/**
+ * Remove the spurs of the skeleton, starting from each end point, the branch is followed until it reaches
+ * a junction, a pixel that splits into 3 or more branches. If the junction is reached within prune_length pixels,
+ * the branch is removed, the junction itself is kept.
+ * Branches that end in another end point are isolated segments, and are not spurs
+ */
+void Thinning::pruneSpurs( Mat& skeleton, int prune_length ) {
+    CV_Assert( skeleton.type() == CV_8UC1 );
+    
+    /* Collect the end points first, so that removing a spur doesn't turn its junction into a new end point to prune */
+    vector<Point> end_points;
+    for( int y = 1; y < skeleton.rows - 1; y++ ) {
+        const uchar * ptr = skeleton.ptr<uchar>(y);
+        for( int x = 1; x < skeleton.cols - 1; x++ ) {
+            if( ptr[x] && countNeighbors( skeleton, x, y ) == 1 )
+                end_points.push_back( Point(x, y) );
+        }
+    }
+    
+    /* 4 neighbors come first, so that the corners of a staircase aren't skipped */
+    const Point steps[8] = {
+        Point(0, -1), Point(1, 0), Point(0, 1), Point(-1, 0),
+        Point(1, -1), Point(1, 1), Point(-1, 1), Point(-1, -1)
+    };
+    
+    vector<Point> branch;
+    for( Point end_point: end_points ) {
+        /* Might have been removed along with another spur */
+        if( !skeleton.at<uchar>(end_point) )
+            continue;
+        
+        branch.clear();
+        branch.push_back( end_point );
+        
+        bool is_spur = false;
+        while( static_cast<int>( branch.size() ) <= prune_length ) {
+            /* Step to the neighbor that's not in the branch yet */
+            Point current = branch.back(), next( -1, -1 );
+            for( Point step: steps ) {
+                Point neighbor = current + step;
+                if( skeleton.at<uchar>(neighbor) && find( branch.begin(), branch.end(), neighbor ) == branch.end() ) {
+                    next = neighbor;
+                    break;
+                }
+            }
+            
+            /* The other end of an isolated segment, or the border of the image */
+            if( next.x <= 0 || next.y <= 0 || next.x >= skeleton.cols - 1 || next.y >= skeleton.rows - 1 )
+                break;
+            
+            if( countTransitions( skeleton, next.x, next.y ) >= 3 ) {
+                is_spur = true;
+                break;
+            }
+            if( countNeighbors( skeleton, next.x, next.y ) == 1 )
+                break;
+            
+            branch.push_back( next );
+        }
+        
+        if( is_spur ) {
+            for( Point point: branch )
+                skeleton.at<uchar>(point) = 0;
+        }
+    }
+}
+
+/**
+ * Apply a two subiteration thinning algorithm, whose conditions are given as lookup tables indexed by getNeighborhoodIndex(),
+ * until no more pixels are removed. Returns the number of iterations that removed any pixel
+ */
+int Thinning::thinLookupTables( Mat& binary, const uchar * table_1, const uchar * table_2 ) {
+    vector<int> update_list;
+    update_list.reserve( binary.total() / 8 );
+    
+    int no_of_iterations = 0;
+    while( true ) {
+        int no_of_updates = thinLookupTable( binary, table_1, update_list );
+        no_of_updates    += thinLookupTable( binary, table_2, update_list );
+        
+        if( no_of_updates == 0 )
+            break;
+        no_of_iterations++;
+    }
+    return no_of_iterations;
+}
+
+/**
+ * Run a single subiteration with the given lookup table, returns the number of removed pixels
+ */
+int Thinning::thinLookupTable( Mat& binary, const uchar * table, vector<int>& update_list ) {
+    const int step = static_cast<int>( binary.step );
+    
+    update_list.clear();
+    for( int y = 1; y < binary.rows - 1; y++ ) {
+        const uchar * row1 = binary.ptr<uchar>(y - 1);
+        const uchar * row2 = binary.ptr<uchar>(y    );
+        const uchar * row3 = binary.ptr<uchar>(y + 1);
+        
+        for( int x = 1; x < binary.cols - 1; x++ ) {
+            if( row2[x] && table[getNeighborhoodIndex( row1, row2, row3, x )] )
+                update_list.push_back( y * step + x );
+        }
+    }
+    
+    /* Update offending points to zero */
+    for( int offset: update_list )
+        binary.data[offset] = 0;
+    
+    return static_cast<int>( update_list.size() );
+}
+
+/**
+ * Count the non zero 8 neighbors of the pixel, which must not be on the border
+ */
+inline int Thinning::countNeighbors( const Mat& binary, int x, int y ) {
+    const uchar * row1 = binary.ptr<uchar>(y - 1);
+    const uchar * row2 = binary.ptr<uchar>(y    );
+    const uchar * row3 = binary.ptr<uchar>(y + 1);
+    
+    return (row1[x-1] != 0) + (row1[x] != 0) + (row1[x+1] != 0) +
+           (row2[x-1] != 0)                  + (row2[x+1] != 0) +
+           (row3[x-1] != 0) + (row3[x] != 0) + (row3[x+1] != 0);
+}
+
+/**
+ * Count the 01 patterns in P2, P3, ..., P9, P2 around the pixel, which must not be on the border,
+ * i.e. the number of branches that meet at the pixel
+ */
+inline int Thinning::countTransitions( const Mat& binary, int x, int y ) {
+    const int index = getNeighborhoodIndex( binary.ptr<uchar>(y - 1), binary.ptr<uchar>(y), binary.ptr<uchar>(y + 1), x );
+    
+    /* Rotate P2 after P9, so that each 01 pattern is a bit that's 0 followed by the next bit that's 1 */
+    const int next = (index >> 1) | ((index & 1) << 7);
+    int transitions = ~index & next & 0xFF;
+    
+    int count = 0;
+    for( ; transitions; transitions &= transitions - 1 )
+        count++;
+    return count;
+}
@@ -0,0 +1,75 @@
+//
+//  Thinning.h
+//  Thinning Algorithm
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __Thinning_Algorithm__Thinning__
+#define __Thinning_Algorithm__Thinning__
+
+#include <iostream>
+#include <functional>
+#include <opencv2/opencv.hpp>
+
+/**
+ * Common interface for the skeletonization algorithms.
+ *
+ * thin() binarizes the image, skeletonizes it, and optionally prunes the short spurs off the skeleton.
+ * By default the image is binarized with Otsu's threshold (dark foreground on light background), another
+ * binarizer can be plugged in, or it can be skipped entirely for images that are already binary,
+ * in which case any non zero pixel is foreground. The output is in 0 and 1s
+ */
+class Thinning {
+public:
+    typedef std::function<cv::Mat( const cv::Mat& )> Binarizer;
+    
+    Thinning();
+    virtual ~Thinning();
+    
+    cv::Mat thin( const cv::Mat& image );
+    
+    void setBinarizer( Binarizer binarizer );
+    void skipBinarization();
+    void setPruneLength( int prune_length );
+    
+    int getIterations();
+    virtual std::string getName() = 0;
+    
+    static cv::Mat otsuBinarization( const cv::Mat& image );
+    static uchar otsuThreshold( const cv::Mat& image );
+    static const uchar * grayscaleRow( const cv::Mat& image, int y, cv::Mat& buffer );
+    static void pruneSpurs( cv::Mat& skeleton, int prune_length );
+    static inline int getNeighborhoodIndex( const uchar * row1, const uchar * row2, const uchar * row3, int x );
+    
+protected:
+    /** Skeletonize the binary image of 0 and 1s in place, returns the number of iterations used */
+    virtual int thinBinary( cv::Mat& binary ) = 0;
+    
+    static int thinLookupTables( cv::Mat& binary, const uchar * table_1, const uchar * table_2 );
+    static int thinLookupTable( cv::Mat& binary, const uchar * table, std::vector<int>& update_list );
+    static inline int countNeighbors( const cv::Mat& binary, int x, int y );
+    static inline int countTransitions( const cv::Mat& binary, int x, int y );
+    
+private:
+    Binarizer binarizer;
+    int pruneLength;
+    int iterations;
+};
+
+/**
+ * For a 3 x 3 sub matrix that has the following arrangement
+ * P9 P2 P3
+ * P8 P1 P4
+ * P7 P6 P5
+ *
+ * packs the neighbors of P1 into a byte, P2 being the lowest bit and P9 the highest bit.
+ * The pixels are expected to be 0 or 1
+ */
+inline int Thinning::getNeighborhoodIndex( const uchar * row1, const uchar * row2, const uchar * row3, int x ) {
+    return  row1[x]           | (row1[x+1] << 1) | (row2[x+1] << 2) | (row3[x+1] << 3) |
+           (row3[x]   << 4)   | (row3[x-1] << 5) | (row2[x-1] << 6) | (row1[x-1] << 7);
+}
+
+#endif /* defined(__Thinning_Algorithm__Thinning__) */
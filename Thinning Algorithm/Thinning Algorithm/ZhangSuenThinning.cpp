@@ -13,6 +13,10 @@
 #include <tbb/tbb.h>
 #endif
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 using namespace std;
 using namespace cv;
 
@@ -21,14 +25,7 @@ using namespace cv;
  * and thresholding it using Otsu's algorithm so that the end matrix is just 0 and 1s
  */
 Mat ZhangSuenThinning::preprocess( Mat& image ) {
-    Mat gray;
-    if( image.channels() == 1 )
-        gray = image.clone();
-    else
-        cvtColor( image, gray, CV_BGR2GRAY );
-    
-    threshold( gray, gray, 0, 1, CV_THRESH_OTSU | CV_THRESH_BINARY_INV );
-    return gray;
+    return otsuBinarization( image );
 }
 
 #ifdef USE_TBB
@@ -122,6 +119,391 @@ Mat ZhangSuenThinning::apply(Mat &image){
 }
 #endif
 
+/**
+ * Apply Zhang Suen's thinning algorithm using the lookup table kernel, the 8 neighbors of each pixel
+ * are packed into a byte, which indexes a precomputed table telling whether the pixel should be removed.
+ * Unlike apply(), the 2nd subiteration uses its own conditions (P2 * P4 * P8 and P2 * P6 * P8) as in the paper
+ */
+Mat ZhangSuenThinning::applyLookupTable( Mat& image ) {
+    Mat gray = preprocess( image );
+    thinLookupTables( gray, getLookupTable( 0 ), getLookupTable( 1 ) );
+    return gray;
+}
+
+/**
+ * Apply Zhang Suen's thinning algorithm, re-examining only the pixels around the frontier of removed pixels.
+ * The first iteration scans the whole image, after that a pixel can only change its outcome for a subiteration
+ * if its neighborhood has changed since the last time that subiteration ran, i.e. one of its neighbors was
+ * removed in either of the two previous subiterations. The cost is then roughly proportional to the number
+ * of removed pixels, rather than the number of iterations times the image area.
+ * The output is the same as applyLookupTable()
+ */
+Mat ZhangSuenThinning::applyFrontier( Mat& image ) {
+    Mat gray = preprocess( image );
+    if( gray.rows < 3 || gray.cols < 3 )
+        return gray;
+    
+    /* The update lists always hold the pixels removed in the last two subiterations, oldest first */
+    vector<int> update_list_1, update_list_2, worklist;
+    update_list_1.reserve( gray.total() / 8 );
+    update_list_2.reserve( gray.total() / 8 );
+    
+    thinLookupTable( gray, getLookupTable( 0 ), update_list_1 );
+    thinLookupTable( gray, getLookupTable( 1 ), update_list_2 );
+    
+    /* Marks the pixels already in the worklist, the border is never examined, so it stays marked */
+    Mat queued( gray.size(), CV_8UC1, Scalar(1) );
+    Mat( queued, Rect(1, 1, gray.cols - 2, gray.rows - 2) ).setTo( Scalar(0) );
+    
+    int subiteration = 0;
+    while( !update_list_1.empty() || !update_list_2.empty() ) {
+        buildWorklist( gray, queued, update_list_1, update_list_2, worklist );
+        
+        /* The oldest update list is no longer needed, reuse it for this subiteration */
+        thinWorklist( gray, subiteration, worklist, update_list_1 );
+        update_list_1.swap( update_list_2 );
+        
+        subiteration = 1 - subiteration;
+    }
+    
+    return gray;
+}
+
+/**
+ * Run a single subiteration on the pixels in the worklist only
+ */
+void ZhangSuenThinning::thinWorklist( Mat& gray, int subiteration, const vector<int>& worklist, vector<int>& update_list ) {
+    const uchar * table = getLookupTable( subiteration );
+    const int step      = static_cast<int>( gray.step );
+    
+    update_list.clear();
+    for( int offset: worklist ) {
+        const uchar * row2 = gray.data + offset;
+        if( table[getNeighborhoodIndex( row2 - step, row2, row2 + step, 0 )] )
+            update_list.push_back( offset );
+    }
+    
+    /* Update offending points to zero */
+    for( int offset: update_list )
+        gray.data[offset] = 0;
+}
+
+/**
+ * Collect the foreground pixels around the removed pixels into the worklist, without duplicates
+ */
+void ZhangSuenThinning::buildWorklist( const Mat& gray, Mat& queued, const vector<int>& update_list_1,
+                                       const vector<int>& update_list_2, vector<int>& worklist ) {
+    const int step = static_cast<int>( gray.step );
+    const int neighbor_offsets[8] = { -step - 1, -step, -step + 1, -1, 1, step - 1, step, step + 1 };
+    
+    worklist.clear();
+    for( const vector<int> * update_list: { &update_list_1, &update_list_2 } ) {
+        for( int offset: *update_list ) {
+            for( int neighbor_offset: neighbor_offsets ) {
+                const int neighbor = offset + neighbor_offset;
+                if( gray.data[neighbor] && !queued.data[neighbor] ) {
+                    queued.data[neighbor] = 1;
+                    worklist.push_back( neighbor );
+                }
+            }
+        }
+    }
+    
+    /* Unmark them again for the next subiteration */
+    for( int offset: worklist )
+        queued.data[offset] = 0;
+}
+
+/**
+ * Apply Zhang Suen's thinning algorithm in parallel over blocks of rows, with double buffering.
+ * Each subiteration reads from one image and writes the thinned rows into the other, so no block ever
+ * reads a pixel that another block is modifying, and nothing is shared between the blocks.
+ * The output is the same as applyLookupTable()
+ */
+Mat ZhangSuenThinning::applyParallel( Mat& image ) {
+    Mat gray = preprocess( image );
+    if( gray.rows < 3 || gray.cols < 3 )
+        return gray;
+    
+    /* The border is never thinned, so both buffers share the same border from the start */
+    Mat buffer = gray.clone();
+    
+#ifdef USE_TBB
+    /* Roughly 16 rows per block, so that the scheduling overhead stays small against the work of a block */
+    const int grain_size = 16;
+#endif
+    
+    int no_of_updates = 1;
+    while( no_of_updates > 0 ) {
+        no_of_updates = 0;
+        
+        for( int subiteration = 0; subiteration < 2; subiteration++ ) {
+#ifdef USE_TBB
+            no_of_updates += tbb::parallel_reduce( tbb::blocked_range<int>( 1, gray.rows - 1, grain_size ), 0,
+                [&]( const tbb::blocked_range<int>& rows, int count ) {
+                    return count + thinRows( gray, buffer, subiteration, rows.begin(), rows.end() );
+                },
+                std::plus<int>()
+            );
+#else
+            no_of_updates += thinRows( gray, buffer, subiteration, 1, gray.rows - 1 );
+#endif
+            std::swap( gray, buffer );
+        }
+    }
+    
+    return gray;
+}
+
+/**
+ * Thin the rows [y_start, y_end) of src for a single subiteration, writing the result into the same rows of dst.
+ * Returns the number of removed pixels
+ */
+int ZhangSuenThinning::thinRows( const Mat& src, Mat& dst, int subiteration, int y_start, int y_end ) {
+    const uchar * table = getLookupTable( subiteration );
+    
+    int count = 0;
+    for( int y = y_start; y < y_end; y++ ) {
+        const uchar * row1 = src.ptr<uchar>(y - 1);
+        const uchar * row2 = src.ptr<uchar>(y    );
+        const uchar * row3 = src.ptr<uchar>(y + 1);
+        uchar * dst_ptr    = dst.ptr<uchar>(y);
+        
+        for( int x = 1; x < src.cols - 1; x++ ) {
+            if( row2[x] && table[getNeighborhoodIndex( row1, row2, row3, x )] ) {
+                dst_ptr[x] = 0;
+                count++;
+            }
+            else
+                dst_ptr[x] = row2[x];
+        }
+    }
+    return count;
+}
+
+/**
+ * Evaluate Zhang Suen's conditions on a whole word of pixels at once with bitwise logic,
+ * p1 holds the pixels themselves, and p[0] to p[7] hold their neighbors P2 to P9, aligned to the same bits.
+ * Returns the bits of the pixels that should be removed. Word only needs the &, |, ^ and ~ operators
+ */
+template <typename Word>
+static inline Word removablePixels( const Word& p1, const Word p[8], int subiteration ) {
+    /* Bit sliced count of the non zero neighbors, s3 s2 s1 s0 holds B(P1) for each bit */
+    Word s0 = p[0] & ~p[0], s1 = s0, s2 = s0, s3 = s0;
+    for( int i = 0; i < 8; i++ ) {
+        Word c0 = s0 & p[i];
+        s0      = s0 ^ p[i];
+        Word c1 = s1 & c0;
+        s1      = s1 ^ c0;
+        Word c2 = s2 & c1;
+        s2      = s2 ^ c1;
+        s3      = s3 | c2;
+    }
+    
+    /* 2 <= B(P1) <= 6 */
+    Word count_ok = (s1 | s2 | s3) & ~(s3 | (s2 & s1 & s0));
+    
+    /* A(P1) == 1, exactly one 01 pattern in P2, P3, ..., P9, P2 */
+    Word one = s0 ^ s0, many = one;
+    for( int i = 0; i < 8; i++ ) {
+        Word transition = ~p[i] & p[(i + 1) & 7];
+        many            = many | (one & transition);
+        one             = one | transition;
+    }
+    
+    Word condition;
+    if( subiteration == 0 ) /* P2 * P4 * P6 == 0 and P4 * P6 * P8 == 0 */
+        condition = ~(p[0] & p[2] & p[4]) & ~(p[2] & p[4] & p[6]);
+    else                    /* P2 * P4 * P8 == 0 and P2 * P6 * P8 == 0 */
+        condition = ~(p[0] & p[2] & p[6]) & ~(p[0] & p[4] & p[6]);
+    
+    return p1 & count_ok & one & ~many & condition;
+}
+
+#ifdef __AVX2__
+/**
+ * 4 words of 64 pixels in an AVX2 register, with just enough operators for removablePixels()
+ */
+struct PackedWords {
+    __m256i v;
+    
+    PackedWords() {}
+    PackedWords( __m256i v ) : v( v ) {}
+    
+    inline PackedWords operator&( const PackedWords& other ) const { return _mm256_and_si256( v, other.v ); }
+    inline PackedWords operator|( const PackedWords& other ) const { return _mm256_or_si256 ( v, other.v ); }
+    inline PackedWords operator^( const PackedWords& other ) const { return _mm256_xor_si256( v, other.v ); }
+    inline PackedWords operator~() const { return _mm256_xor_si256( v, _mm256_set1_epi64x( -1 ) ); }
+};
+#endif
+
+/**
+ * Apply Zhang Suen's thinning algorithm on a bit packed copy of the image, 64 pixels are thinned at once
+ * with bitwise logic, or 256 pixels when compiled with AVX2 (-mavx2). The output is the same as applyLookupTable().
+ * The binarization of preprocess() is folded into the packing, so the only full size byte image is the output
+ */
+Mat ZhangSuenThinning::applyBitPacked( Mat& image ) {
+    const uchar thresh = otsuThreshold( image );
+    
+    BitPackedImage packed( image.rows, image.cols );
+    Mat buffer;
+    for( int y = 0; y < image.rows; y++ )
+        packed.packRow( y, grayscaleRow( image, y, buffer ), thresh, true );
+    
+    thinBitPacked( packed );
+    return packed.unpack();
+}
+
+/**
+ * Thin a bit packed binary image in place. This is the memory bounded entry point: the image can be filled
+ * with BitPackedImage::packRow() and read back with unpackRow() one row at a time, so no byte image of the whole
+ * size is ever needed, the peak memory is the packed image and its double buffer, a quarter of a CV_8UC1 Mat
+ */
+void ZhangSuenThinning::thinBitPacked( BitPackedImage& image ) {
+    if( image.rows < 3 || image.cols < 3 )
+        return;
+    
+    /* The first and last columns are the border, and are never removed */
+    const int no_of_words = image.wordsPerRow - 2;
+    vector<uint64_t> interior( no_of_words, ~uint64_t(0) );
+    interior[0] &= ~uint64_t(1);
+    interior[(image.cols - 1) >> 6] &= ~(uint64_t(1) << ((image.cols - 1) & 63));
+    
+    /* Double buffered just like applyParallel(), the first and last rows are shared from the start */
+    BitPackedImage buffer = image;
+    
+#ifdef USE_TBB
+    const int grain_size = 16;
+#endif
+    
+    bool changed = true;
+    while( changed ) {
+        changed = false;
+        
+        for( int subiteration = 0; subiteration < 2; subiteration++ ) {
+#ifdef USE_TBB
+            changed |= tbb::parallel_reduce( tbb::blocked_range<int>( 1, image.rows - 1, grain_size ), false,
+                [&]( const tbb::blocked_range<int>& rows, bool result ) {
+                    return thinBitPackedRows( image, buffer, interior, subiteration, rows.begin(), rows.end() ) || result;
+                },
+                std::logical_or<bool>()
+            );
+#else
+            changed |= thinBitPackedRows( image, buffer, interior, subiteration, 1, image.rows - 1 );
+#endif
+            std::swap( image.words, buffer.words );
+        }
+    }
+}
+
+/**
+ * Thin the rows [y_start, y_end) of src for a single subiteration, writing the result into the same rows of dst.
+ * Returns whether any pixel was removed
+ */
+bool ZhangSuenThinning::thinBitPackedRows( const BitPackedImage& src, BitPackedImage& dst, const vector<uint64_t>& interior,
+                                           int subiteration, int y_start, int y_end ) {
+    const int no_of_words = src.wordsPerRow - 2;
+    uint64_t changed = 0;
+    
+    for( int y = y_start; y < y_end; y++ ) {
+        const uint64_t * row1 = src.ptr(y - 1);
+        const uint64_t * row2 = src.ptr(y    );
+        const uint64_t * row3 = src.ptr(y + 1);
+        uint64_t * dst_ptr    = dst.ptr(y);
+        
+        int i = 0;
+        
+#ifdef __AVX2__
+        /* East and west neighbors are the same words shifted by one pixel, carrying a bit over from the next or previous word */
+        #define LOAD(row, offset) PackedWords( _mm256_loadu_si256( reinterpret_cast<const __m256i *>( row + i + offset ) ) )
+        #define EAST(row) PackedWords( _mm256_or_si256( _mm256_srli_epi64( LOAD(row, 0).v, 1 ), _mm256_slli_epi64( LOAD(row, 1).v, 63 ) ) )
+        #define WEST(row) PackedWords( _mm256_or_si256( _mm256_slli_epi64( LOAD(row, 0).v, 1 ), _mm256_srli_epi64( LOAD(row, -1).v, 63 ) ) )
+        
+        __m256i changed_words = _mm256_setzero_si256();
+        for( ; i + 4 <= no_of_words; i += 4 ) {
+            const PackedWords p1 = LOAD(row2, 0);
+            const PackedWords p[8] = {
+                /* P2      , P3        , P4        , P5        , P6        , P7        , P8        , P9 */
+                LOAD(row1, 0), EAST(row1), EAST(row2), EAST(row3), LOAD(row3, 0), WEST(row3), WEST(row2), WEST(row1)
+            };
+            
+            const PackedWords removable = removablePixels( p1, p, subiteration ) & LOAD(&interior[0], 0);
+            _mm256_storeu_si256( reinterpret_cast<__m256i *>( dst_ptr + i ), _mm256_andnot_si256( removable.v, p1.v ) );
+            changed_words = _mm256_or_si256( changed_words, removable.v );
+        }
+        changed |= !_mm256_testz_si256( changed_words, changed_words );
+        
+        #undef WEST
+        #undef EAST
+        #undef LOAD
+#endif
+        
+        for( ; i < no_of_words; i++ ) {
+            const uint64_t p1 = row2[i];
+            const uint64_t p[8] = {
+                /* P2  , P3                                   , P4                                   , P5 */
+                row1[i], (row1[i] >> 1) | (row1[i + 1] << 63), (row2[i] >> 1) | (row2[i + 1] << 63), (row3[i] >> 1) | (row3[i + 1] << 63),
+                /* P6  , P7                                   , P8                                   , P9 */
+                row3[i], (row3[i] << 1) | (row3[i - 1] >> 63), (row2[i] << 1) | (row2[i - 1] >> 63), (row1[i] << 1) | (row1[i - 1] >> 63)
+            };
+            
+            const uint64_t removable = removablePixels( p1, p, subiteration ) & interior[i];
+            dst_ptr[i]  = p1 & ~removable;
+            changed    |= removable;
+        }
+    }
+    
+    return changed != 0;
+}
+
+/**
+ * Skeletonize through the common Thinning interface, using the lookup table kernel
+ */
+int ZhangSuenThinning::thinBinary( Mat& binary ) {
+    return thinLookupTables( binary, getLookupTable( 0 ), getLookupTable( 1 ) );
+}
+
+string ZhangSuenThinning::getName() {
+    return "Zhang-Suen";
+}
+
+/**
+ * Lookup tables for both subiterations, indexed by the packed neighborhood from getNeighborhoodIndex().
+ * An entry is 1 if P1 should be removed given that neighborhood
+ */
+const uchar * ZhangSuenThinning::getLookupTable( int subiteration ) {
+    struct LookupTables {
+        uchar tables[2][256];
+        
+        LookupTables() {
+            for( int index = 0; index < 256; index++ ) {
+                /* {P2, P3, P4, P5, P6, P7, P8, P9, P2} */
+                int p[9];
+                for( int i = 0; i < 8; i++ )
+                    p[i] = (index >> i) & 1;
+                p[8] = p[0];
+                
+                int non_zeros = 0, transitions = 0;
+                for( int i = 0; i < 8; i++ ) {
+                    non_zeros   += p[i];
+                    transitions += p[i + 1] - p[i] == 1;
+                }
+                
+                bool removable = transitions == 1 && non_zeros >= 2 && non_zeros <= 6;
+                
+                /* P2 * P4 * P6 == 0 and P4 * P6 * P8 == 0 */
+                tables[0][index] = removable && (p[0] * p[2] * p[4] == 0) && (p[2] * p[4] * p[6] == 0);
+                
+                /* P2 * P4 * P8 == 0 and P2 * P6 * P8 == 0 */
+                tables[1][index] = removable && (p[0] * p[2] * p[6] == 0) && (p[0] * p[4] * p[6] == 0);
+            }
+        }
+    };
+    
+    static const LookupTables lookup_tables;
+    return lookup_tables.tables[subiteration];
+}
+
 /**
  * Count number of non zero neighbors around P1
  */
@@ -17,15 +17,33 @@
 
 #include <iostream>
 #include <opencv2/opencv.hpp>
+#include "Thinning.h"
+#include "BitPackedImage.h"
 
 #define USE_TBB
 
-class ZhangSuenThinning {
+class ZhangSuenThinning : public Thinning {
 public:
     static cv::Mat apply( cv::Mat& image );
+    static cv::Mat applyLookupTable( cv::Mat& image );
+    static cv::Mat applyFrontier( cv::Mat& image );
+    static cv::Mat applyParallel( cv::Mat& image );
+    static cv::Mat applyBitPacked( cv::Mat& image );
+    static void thinBitPacked( BitPackedImage& image );
+    
+    std::string getName();
     
 protected:
+    int thinBinary( cv::Mat& binary );
+    
     static cv::Mat preprocess( cv::Mat& image );
+    static int thinRows( const cv::Mat& src, cv::Mat& dst, int subiteration, int y_start, int y_end );
+    static bool thinBitPackedRows( const BitPackedImage& src, BitPackedImage& dst, const std::vector<uint64_t>& interior,
+                                   int subiteration, int y_start, int y_end );
+    static void thinWorklist( cv::Mat& gray, int subiteration, const std::vector<int>& worklist, std::vector<int>& update_list );
+    static void buildWorklist( const cv::Mat& gray, cv::Mat& queued, const std::vector<int>& update_list_1,
+                               const std::vector<int>& update_list_2, std::vector<int>& worklist );
+    static const uchar * getLookupTable( int subiteration );
     static inline int countNonZeroNeighbors( std::vector<int>& neighbors );
     static inline int countTransitionPatterns( std::vector<int>& neighbors );
     static inline bool checkCondition( std::vector<int>& p );
@@ -7,11 +7,44 @@
 //
 
 #include <iostream>
+#include <iomanip>
 #include "ZhangSuenThinning.h"
+#include "GuoHallThinning.h"
+#include "MedialAxisThinning.h"
+#include "SkeletonGraph.h"
 
 using namespace std;
 using namespace cv;
 
+/* Compare the iteration counts and throughput of the thinning algorithms on the same images */
+void benchmark( const vector<string>& filenames ) {
+    ZhangSuenThinning zhang_suen;
+    GuoHallThinning guo_hall;
+    MedialAxisThinning medial_axis;
+    vector<Thinning *> algorithms = { &zhang_suen, &guo_hall, &medial_axis };
+    
+    for( string filename: filenames ) {
+        Mat image = imread( filename );
+        
+        /* Binarize only once, so that just the skeletonization is timed */
+        Mat binary = Thinning::otsuBinarization( image );
+        cout << filename << " (" << binary.cols << " x " << binary.rows << ")" << endl;
+        
+        for( Thinning * algorithm: algorithms ) {
+            algorithm->skipBinarization();
+            
+            int64 start     = getTickCount();
+            Mat skeleton    = algorithm->thin( binary );
+            double elapsed  = (getTickCount() - start) / getTickFrequency();
+            
+            cout << "    " << setw(12) << left << algorithm->getName() << ": "
+                 << algorithm->getIterations() << " iterations, "
+                 << countNonZero( skeleton ) << " skeleton pixels, "
+                 << binary.total() / elapsed / 1e6 << " MP/s" << endl;
+        }
+    }
+}
+
 int main(int argc, const char * argv[]) {
     namedWindow( "" );
     moveWindow( "", 0, 0 );
@@ -22,16 +55,28 @@ int main(int argc, const char * argv[]) {
         "/Users/saburookita/Desktop/Demon.png"
     };
     
+    benchmark( filenames );
     
     for( string filename: filenames ) {
         Mat image = imread( filename );
         
         Mat gray = ZhangSuenThinning::apply( image );
         
+        SkeletonGraph graph( gray );
+        cout << filename << ": " << graph.getNodesCount() << " nodes, " << graph.getEdgesCount() << " edges" << endl;
+        
         /* Since the output is in 0 and 1s, scale it to 255 so that it's visible */
         gray *= 255;
         cvtColor( gray, gray, CV_GRAY2BGR );
         
+        /* Mark the junctions in red, and the end points in green */
+        for( int i = 0; i < graph.getNodesCount(); i++ ) {
+            if( graph.nodeTypes[i] == SkeletonGraph::JUNCTION )
+                circle( gray, graph.nodePoints[i], 3, Scalar(0, 0, 255) );
+            else if( graph.nodeTypes[i] == SkeletonGraph::END_POINT )
+                circle( gray, graph.nodePoints[i], 3, Scalar(0, 255, 0) );
+        }
+        
         /* Append the original image with thinned image together */
         Mat appended( gray.rows, gray.cols * 2, CV_8UC3 );
         image.copyTo( Mat(appended, Rect(0, 0, image.cols, image.rows)) );
@@ -0,0 +1,318 @@
+//
+//  DenseVoxelGrid.cpp
+//  VoxelCarving
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#include "DenseVoxelGrid.h"
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <climits>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Projects the occupied voxels of a range of occupancy words with one projection matrix,
+ * the voxel coordinates are worked out from their indices
+ */
+class VoxelProjector : public ParallelLoopBody {
+public:
+    VoxelProjector( int y_div, int z_div, float voxel_size, const Point3f& voxel_origin,
+                    const Mat& mask, const Mat& projection_mat )
+    : yDiv( y_div ), zDiv( z_div ), voxelSize( voxel_size ), voxelOrigin( voxel_origin ), mask( mask ) {
+        CV_Assert( projection_mat.type() == CV_32FC1 && projection_mat.rows == 3 && projection_mat.cols == 4 );
+        for( int i = 0; i < 12; i++ )
+            projection[i] = projection_mat.at<float>( i / 4, i % 4 );
+    }
+
+protected:
+    /**
+     * Project the voxel at the given index, returns false if it falls outside of the mask image or its foreground
+     */
+    inline bool project( size_t index, int& x, int& y, float& depth ) const {
+        int z_index = static_cast<int>( index % zDiv );
+        size_t rest = index / zDiv;
+        int y_index = static_cast<int>( rest % yDiv );
+        int x_index = static_cast<int>( rest / yDiv );
+        
+        float vx = voxelOrigin.x + x_index * voxelSize;
+        float vy = voxelOrigin.y + y_index * voxelSize;
+        float vz = voxelOrigin.z + z_index * voxelSize;
+        
+        const float * p = projection;
+        float u = p[0] * vx + p[1] * vy + p[2]  * vz + p[3];
+        float v = p[4] * vx + p[5] * vy + p[6]  * vz + p[7];
+        depth   = p[8] * vx + p[9] * vy + p[10] * vz + p[11];
+        
+        /* Then divide by the w component */
+        x = u / depth;
+        y = v / depth;
+        
+        if( x < 0 || x >= mask.cols || y < 0 || y >= mask.rows )
+            return false;
+        return mask.ptr<uchar>(y)[x] != 0;
+    }
+    
+    int yDiv, zDiv;
+    float voxelSize;
+    Point3f voxelOrigin;
+    const Mat& mask;
+    float projection[12];
+};
+
+/**
+ * Clears the bits of the voxels that are projected outside of the mask's foreground,
+ * each thread only writes to its own range of words
+ */
+class VoxelCarver : public VoxelProjector {
+public:
+    VoxelCarver( int y_div, int z_div, float voxel_size, const Point3f& voxel_origin,
+                 const Mat& mask, const Mat& projection_mat, vector<uint64_t>& occupancy )
+    : VoxelProjector( y_div, z_div, voxel_size, voxel_origin, mask, projection_mat ), occupancy( occupancy ) {
+    }
+    
+    void operator()( const Range& range ) const {
+        for( int word = range.start; word < range.end; word++ ) {
+            uint64_t bits       = occupancy[word];
+            uint64_t remaining  = bits;
+            
+            while( remaining ) {
+                int bit = __builtin_ctzll( remaining );
+                remaining &= remaining - 1;
+                
+                int x, y;
+                float depth;
+                if( !project( static_cast<size_t>( word ) * 64 + bit, x, y, depth ) )
+                    bits &= ~(1ULL << bit);
+            }
+            
+            occupancy[word] = bits;
+        }
+    }
+
+private:
+    vector<uint64_t>& occupancy;
+};
+
+/**
+ * Keeps the color of the nearest view for each surviving voxel, the survivors of a word
+ * are stored one after another starting from the word's offset
+ */
+class VoxelColorer : public VoxelProjector {
+public:
+    VoxelColorer( int y_div, int z_div, float voxel_size, const Point3f& voxel_origin,
+                  const Mat& mask, const Mat& projection_mat, const Mat& image,
+                  const vector<uint64_t>& occupancy, const vector<unsigned int>& word_offsets,
+                  vector<float>& depths, vector<Vec3b>& colors )
+    : VoxelProjector( y_div, z_div, voxel_size, voxel_origin, mask, projection_mat ),
+      image( image ), occupancy( occupancy ), wordOffsets( word_offsets ), depths( depths ), colors( colors ) {
+    }
+    
+    void operator()( const Range& range ) const {
+        for( int word = range.start; word < range.end; word++ ) {
+            uint64_t remaining = occupancy[word];
+            unsigned int i     = wordOffsets[word];
+            
+            for( ; remaining; i++ ) {
+                int bit = __builtin_ctzll( remaining );
+                remaining &= remaining - 1;
+                
+                int x, y;
+                float depth;
+                if( project( static_cast<size_t>( word ) * 64 + bit, x, y, depth ) && depth < depths[i] ) {
+                    depths[i] = depth;
+                    colors[i] = image.at<Vec3b>(y, x);
+                }
+            }
+        }
+    }
+
+private:
+    const Mat& image;
+    const vector<uint64_t>& occupancy;
+    const vector<unsigned int>& wordOffsets;
+    vector<float>& depths;
+    vector<Vec3b>& colors;
+};
+
+DenseVoxelGrid::DenseVoxelGrid( int x_div, int y_div, int z_div, float voxel_size, cv::Point3f voxel_origin ) :
+    xDiv( x_div ),
+    yDiv( y_div ),
+    zDiv( z_div ),
+    voxelSize( voxel_size ),
+    voxelOrigin( voxel_origin ),
+    outputScale( 1.0f, 1.0f, 1.0f ),
+    outputOffset( 0.0f, 0.0f, 0.0f )
+{
+    /* Every voxel starts out occupied, except the padding bits of the last word */
+    size_t no_of_voxels = static_cast<size_t>( x_div ) * y_div * z_div;
+    occupancy.assign( (no_of_voxels + 63) / 64, ~0ULL );
+    if( no_of_voxels % 64 )
+        occupancy.back() = (1ULL << (no_of_voxels % 64)) - 1;
+    
+    countSurvivors();
+}
+
+DenseVoxelGrid::~DenseVoxelGrid() {
+    
+}
+
+/**
+ * Returns the coordinates of the occupied voxels, in the same order as their depths and colors
+ */
+vector<cv::Point3f> DenseVoxelGrid::getGrid() {
+    vector<Point3f> grid;
+    grid.reserve( getSize() );
+    
+    for( size_t word = 0; word < occupancy.size(); word++ ) {
+        for( uint64_t remaining = occupancy[word]; remaining; remaining &= remaining - 1 ) {
+            size_t index = word * 64 + __builtin_ctzll( remaining );
+            int z = static_cast<int>( index % zDiv );
+            int y = static_cast<int>( (index / zDiv) % yDiv );
+            int x = static_cast<int>( index / zDiv / yDiv );
+            
+            Point3f voxel = voxelOrigin + Point3f( x, y, z ) * voxelSize;
+            grid.push_back( Point3f( voxel.x * outputScale.x + outputOffset.x,
+                                     voxel.y * outputScale.y + outputOffset.y,
+                                     voxel.z * outputScale.z + outputOffset.z ) );
+        }
+    }
+    
+    return grid;
+}
+
+vector<float>& DenseVoxelGrid::getDepths() {
+    return this->depths;
+}
+
+vector<cv::Vec3b>& DenseVoxelGrid::getColors() {
+    return this->colors;
+}
+
+unsigned int DenseVoxelGrid::getSize() {
+    return wordOffsets.back();
+}
+
+bool DenseVoxelGrid::isOccupied( int x, int y, int z ) {
+    size_t index = (static_cast<size_t>( x ) * yDiv + y) * zDiv + z;
+    return (occupancy[index / 64] >> (index % 64)) & 1;
+}
+
+/**
+ * Find how many voxels are occupied before each word of the bitmap, and resize depths and colors to fit the survivors
+ */
+void DenseVoxelGrid::countSurvivors() {
+    wordOffsets.resize( occupancy.size() + 1 );
+    wordOffsets[0] = 0;
+    for( size_t word = 0; word < occupancy.size(); word++ )
+        wordOffsets[word + 1] = wordOffsets[word] + __builtin_popcountll( occupancy[word] );
+    
+    depths.assign( wordOffsets.back(), FLT_MAX );
+    colors.assign( wordOffsets.back(), Vec3b() );
+}
+
+/*
+ * Perform visibility carving for several different camera viewpoints. Voxels are carved away view by view,
+ * then each survivor gets its depth and color from the nearest of the views
+ */
+void DenseVoxelGrid::carve( std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks,
+                            std::vector<cv::Mat>& projection_matrices ) {
+    const Range words( 0, static_cast<int>( occupancy.size() ) );
+    
+    for( size_t k = 0; k < projection_matrices.size(); k++ )
+        parallel_for_( words, VoxelCarver( yDiv, zDiv, voxelSize, voxelOrigin, masks[k], projection_matrices[k], occupancy ) );
+    
+    countSurvivors();
+    
+    for( size_t k = 0; k < projection_matrices.size(); k++ )
+        parallel_for_( words, VoxelColorer( yDiv, zDiv, voxelSize, voxelOrigin, masks[k], projection_matrices[k], images[k],
+                                            occupancy, wordOffsets, depths, colors ) );
+}
+
+/**
+ * Normalize the voxel coordinates, so they stay between -1.0 an 1.0
+ */
+void DenseVoxelGrid::normalize() {
+    int min_index[3] = { INT_MAX, INT_MAX, INT_MAX };
+    int max_index[3] = { -1, -1, -1 };
+    
+    for( size_t word = 0; word < occupancy.size(); word++ ) {
+        for( uint64_t remaining = occupancy[word]; remaining; remaining &= remaining - 1 ) {
+            size_t index = word * 64 + __builtin_ctzll( remaining );
+            int indices[3] = {
+                static_cast<int>( index / zDiv / yDiv ),
+                static_cast<int>( (index / zDiv) % yDiv ),
+                static_cast<int>( index % zDiv ),
+            };
+            
+            for( int i = 0; i < 3; i++ ) {
+                min_index[i] = MIN( min_index[i], indices[i] );
+                max_index[i] = MAX( max_index[i], indices[i] );
+            }
+        }
+    }
+    
+    if( max_index[0] < 0 )
+        return;
+    
+    Point3f min_vec = voxelOrigin + Point3f( min_index[0], min_index[1], min_index[2] ) * voxelSize;
+    Point3f length  = Point3f( max_index[0] - min_index[0], max_index[1] - min_index[1], max_index[2] - min_index[2] ) * (voxelSize * 0.5f);
+    
+    /* A single layer of voxels just ends up at -1.0 */
+    outputScale  = Point3f( length.x > 0 ? 1.0f / length.x : 1.0f,
+                            length.y > 0 ? 1.0f / length.y : 1.0f,
+                            length.z > 0 ? 1.0f / length.z : 1.0f );
+    outputOffset = Point3f( -min_vec.x * outputScale.x - 1.0f,
+                            -min_vec.y * outputScale.y - 1.0f,
+                            -min_vec.z * outputScale.z - 1.0f );
+}
+
+/**
+ * Save the carved voxel grid as a PLY model file
+ */
+void DenseVoxelGrid::saveAsPLY( const std::string filename ) {
+    ofstream output( filename );
+    
+    vector<Point3f> grid = getGrid();
+    unsigned int size = static_cast<unsigned int>(grid.size());
+    
+    output << "ply" << endl;
+    output << "format ascii 1.0" << endl;
+    output << "element vertex " << size << endl;
+    output << "property float x" << endl;
+    output << "property float y" << endl;
+    output << "property float z" << endl;
+    output << "property uchar red" << endl;
+    output << "property uchar green" << endl;
+    output << "property uchar blue" << endl;
+    output << "element face " << size / 3 << endl;
+    output << "property list uchar int vertex_indices" << endl;
+    output << "end_header" << endl;
+    
+    /* Write vertex and vertex color */
+    for( unsigned int i = 0; i < size; i++ ) {
+        Point3f& voxel = grid[i];
+        output  << voxel.x << " "
+                << voxel.y << " "
+                << voxel.z << " ";
+        
+        Vec3b& color = colors[i];
+        output  << static_cast<int>(color[2]) << " "
+                << static_cast<int>(color[1]) << " "
+                << static_cast<int>(color[0]) << endl;
+    }
+    
+    /* Write the faces */
+    for( unsigned int i = 0; i < size; i += 3 )  {
+        output  << "3 " << i
+                << " "  << (i + 1)
+                << " "  << (i + 2) << endl;
+    }
+    
+    output.close();
+}
@@ -0,0 +1,60 @@
+//
+//  DenseVoxelGrid.h
+//  VoxelCarving
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __VoxelCarving__DenseVoxelGrid__
+#define __VoxelCarving__DenseVoxelGrid__
+
+#include <iostream>
+#include <stdint.h>
+#include <opencv2/opencv.hpp>
+
+/**
+ * Voxel grid where the coordinates of each voxel are implied by its (x, y, z) index, and whether
+ * it's still occupied is a single bit. Colors and depths are kept in separate compact arrays,
+ * which are only allocated for the voxels that survive the carving, in the order of their indices.
+ * A 512 x 512 x 512 grid takes 16 MB of occupancy bits, plus 8 MB to locate the survivors
+ */
+class DenseVoxelGrid {
+public:
+    DenseVoxelGrid( int x_div, int y_div, int z_div, float voxel_size, cv::Point3f voxel_origin );
+    ~DenseVoxelGrid();
+    
+    std::vector<cv::Point3f> getGrid();
+    std::vector<float>& getDepths();
+    std::vector<cv::Vec3b>& getColors();
+    unsigned int getSize();
+    bool isOccupied( int x, int y, int z );
+    
+    void carve( std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks, std::vector<cv::Mat>& projection_matrices );
+    void normalize();
+    
+    void saveAsPLY( const std::string filename );
+
+protected:
+    void countSurvivors();
+
+protected:
+    int xDiv, yDiv, zDiv;
+    float voxelSize;
+    cv::Point3f voxelOrigin;
+    
+    /* Output coordinates are voxel coordinates * outputScale + outputOffset, changed by normalize() */
+    cv::Point3f outputScale;
+    cv::Point3f outputOffset;
+    
+    /* One bit per voxel, in the same x, y, z order as VoxelGrid, set while the voxel is occupied */
+    std::vector<uint64_t> occupancy;
+    
+    /* Number of occupied voxels before each word of the bitmap, which locates each survivor in depths and colors */
+    std::vector<unsigned int> wordOffsets;
+    
+    std::vector<float> depths;
+    std::vector<cv::Vec3b> colors;
+};
+
+#endif /* defined(__VoxelCarving__DenseVoxelGrid__) */
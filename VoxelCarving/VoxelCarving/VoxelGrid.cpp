@@ -12,9 +12,18 @@
 #include <sstream>
 #include <fstream>
 
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 using namespace cv;
 
+/* Number of voxels that each task of carve() goes through, a multiple of the SIMD width */
+static const int CARVE_BLOCK_SIZE = 4096;
+
 VoxelGrid::VoxelGrid(){}
 
 VoxelGrid::VoxelGrid( int x_div, int y_div, int z_div, float voxel_size, cv::Point3f voxel_origin ) :
@@ -58,82 +67,255 @@ void VoxelGrid::initVoxelGrid( int x_div, int y_div, int z_div, cv::Point3f& vox
     }
 }
 
-/*
- * Perform visibility carving for several different camera viewpoints
+#ifdef __SSE2__
+/**
+ * Split 4 consecutive Point3f into a vector of their x, y and z
  */
-void VoxelGrid::carve(std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks,
-                      std::vector<cv::Mat>& projection_matrices ){
+static inline void loadVoxels( const Point3f * voxels, __m128& x, __m128& y, __m128& z ) {
+    const float * ptr = reinterpret_cast<const float *>( voxels );
+    __m128 a = _mm_loadu_ps( ptr );         /* x0 y0 z0 x1 */
+    __m128 b = _mm_loadu_ps( ptr + 4 );     /* y1 z1 x2 y2 */
+    __m128 c = _mm_loadu_ps( ptr + 8 );     /* z2 x3 y3 z3 */
     
-    Mat projected_coord (3, 1, CV_32FC1);
-    Mat voxel_coord     (4, 1, CV_32FC1);
+    x = _mm_shuffle_ps( _mm_shuffle_ps( a, a, _MM_SHUFFLE(3, 3, 0, 0) ), _mm_shuffle_ps( b, c, _MM_SHUFFLE(1, 1, 2, 2) ), _MM_SHUFFLE(2, 0, 2, 0) );
+    y = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE(0, 0, 1, 1) ), _mm_shuffle_ps( b, c, _MM_SHUFFLE(2, 2, 3, 3) ), _MM_SHUFFLE(2, 0, 2, 0) );
+    z = _mm_shuffle_ps( _mm_shuffle_ps( a, b, _MM_SHUFFLE(1, 1, 2, 2) ), _mm_shuffle_ps( c, c, _MM_SHUFFLE(3, 3, 0, 0) ), _MM_SHUFFLE(2, 0, 2, 0) );
+}
+#endif
+
+/**
+ * Project the voxels with the 3x4 projection matrix, into their image coordinates (truncated like the int casts
+ * of the original per voxel Mat multiplication) and depths. The matrix is kept in registers, and the voxels are
+ * projected 8 at a time with AVX, or 4 at a time with SSE2, the remaining ones one by one
+ */
+static inline void projectVoxels( const float * p, const Point3f * voxels, int count, int * xs, int * ys, float * ws ) {
+    int i = 0;
+
+#ifdef __AVX__
+    const __m256 p0 = _mm256_set1_ps( p[0] ), p1 = _mm256_set1_ps( p[1] ), p2  = _mm256_set1_ps( p[2] ),  p3  = _mm256_set1_ps( p[3] );
+    const __m256 p4 = _mm256_set1_ps( p[4] ), p5 = _mm256_set1_ps( p[5] ), p6  = _mm256_set1_ps( p[6] ),  p7  = _mm256_set1_ps( p[7] );
+    const __m256 p8 = _mm256_set1_ps( p[8] ), p9 = _mm256_set1_ps( p[9] ), p10 = _mm256_set1_ps( p[10] ), p11 = _mm256_set1_ps( p[11] );
     
-    float * voxel_coord_ptr     = voxel_coord.ptr<float>();
-    float * projected_coord_ptr = projected_coord.ptr<float>();
+    for( ; i + 8 <= count; i += 8 ) {
+        __m128 x_lo, y_lo, z_lo, x_hi, y_hi, z_hi;
+        loadVoxels( voxels + i,     x_lo, y_lo, z_lo );
+        loadVoxels( voxels + i + 4, x_hi, y_hi, z_hi );
+        
+        __m256 x = _mm256_insertf128_ps( _mm256_castps128_ps256( x_lo ), x_hi, 1 );
+        __m256 y = _mm256_insertf128_ps( _mm256_castps128_ps256( y_lo ), y_hi, 1 );
+        __m256 z = _mm256_insertf128_ps( _mm256_castps128_ps256( z_lo ), z_hi, 1 );
+        
+        __m256 u = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( p0, x ), _mm256_mul_ps( p1, y ) ), _mm256_add_ps( _mm256_mul_ps( p2,  z ), p3 ) );
+        __m256 v = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( p4, x ), _mm256_mul_ps( p5, y ) ), _mm256_add_ps( _mm256_mul_ps( p6,  z ), p7 ) );
+        __m256 w = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( p8, x ), _mm256_mul_ps( p9, y ) ), _mm256_add_ps( _mm256_mul_ps( p10, z ), p11 ) );
+        
+        _mm256_storeu_si256( reinterpret_cast<__m256i *>( xs + i ), _mm256_cvttps_epi32( _mm256_div_ps( u, w ) ) );
+        _mm256_storeu_si256( reinterpret_cast<__m256i *>( ys + i ), _mm256_cvttps_epi32( _mm256_div_ps( v, w ) ) );
+        _mm256_storeu_ps( ws + i, w );
+    }
+#elif defined(__SSE2__)
+    const __m128 p0 = _mm_set1_ps( p[0] ), p1 = _mm_set1_ps( p[1] ), p2  = _mm_set1_ps( p[2] ),  p3  = _mm_set1_ps( p[3] );
+    const __m128 p4 = _mm_set1_ps( p[4] ), p5 = _mm_set1_ps( p[5] ), p6  = _mm_set1_ps( p[6] ),  p7  = _mm_set1_ps( p[7] );
+    const __m128 p8 = _mm_set1_ps( p[8] ), p9 = _mm_set1_ps( p[9] ), p10 = _mm_set1_ps( p[10] ), p11 = _mm_set1_ps( p[11] );
     
-    for( int k = 0; k < projection_matrices.size(); k++ ) {
-        vector<cv::Point3f> new_grid;
-        vector<cv::Vec3b> new_colors;
-        vector<float> new_depths;
-        
-        Mat& image = images[k];
-        Mat& mask  = masks[k];
-        Mat& projection_mat = projection_matrices[k];
-        
-        for( int i = 0; i < grid.size(); i++ ) {
-            Point3f& voxel = grid[i];
-            voxel_coord_ptr[0] = voxel.x;
-            voxel_coord_ptr[1] = voxel.y;
-            voxel_coord_ptr[2] = voxel.z;
-            voxel_coord_ptr[3] = 1.0;
-            
-            
-            /* Project the voxel coord back using corresponding projection matrix */
-            projected_coord = projection_mat * voxel_coord;
+    for( ; i + 4 <= count; i += 4 ) {
+        __m128 x, y, z;
+        loadVoxels( voxels + i, x, y, z );
+        
+        __m128 u = _mm_add_ps( _mm_add_ps( _mm_mul_ps( p0, x ), _mm_mul_ps( p1, y ) ), _mm_add_ps( _mm_mul_ps( p2,  z ), p3 ) );
+        __m128 v = _mm_add_ps( _mm_add_ps( _mm_mul_ps( p4, x ), _mm_mul_ps( p5, y ) ), _mm_add_ps( _mm_mul_ps( p6,  z ), p7 ) );
+        __m128 w = _mm_add_ps( _mm_add_ps( _mm_mul_ps( p8, x ), _mm_mul_ps( p9, y ) ), _mm_add_ps( _mm_mul_ps( p10, z ), p11 ) );
+        
+        _mm_storeu_si128( reinterpret_cast<__m128i *>( xs + i ), _mm_cvttps_epi32( _mm_div_ps( u, w ) ) );
+        _mm_storeu_si128( reinterpret_cast<__m128i *>( ys + i ), _mm_cvttps_epi32( _mm_div_ps( v, w ) ) );
+        _mm_storeu_ps( ws + i, w );
+    }
+#endif
+    
+    for( ; i < count; i++ ) {
+        const Point3f& voxel = voxels[i];
+        float u = p[0] * voxel.x + p[1] * voxel.y + p[2]  * voxel.z + p[3];
+        float v = p[4] * voxel.x + p[5] * voxel.y + p[6]  * voxel.z + p[7];
+        float w = p[8] * voxel.x + p[9] * voxel.y + p[10] * voxel.z + p[11];
+        
+        xs[i] = u / w;
+        ys[i] = v / w;
+        ws[i] = w;
+    }
+}
+
+/**
+ * First half of carving a view: projects each block of voxels, marks the ones that land on the foreground,
+ * updates their depths and colors, and counts how many of them there are in the block
+ */
+class BlockCarver : public ParallelLoopBody {
+public:
+    BlockCarver( const Mat& image, const Mat& mask, const Mat& projection_mat, const vector<Point3f>& grid,
+                 vector<float>& depths, vector<Vec3b>& colors, vector<uchar>& keep, vector<int>& block_counts )
+    : image( image ), mask( mask ), grid( grid ), depths( depths ), colors( colors ), keep( keep ), blockCounts( block_counts ) {
+        CV_Assert( projection_mat.type() == CV_32FC1 && projection_mat.rows == 3 && projection_mat.cols == 4 );
+        for( int i = 0; i < 12; i++ )
+            projection[i] = projection_mat.at<float>( i / 4, i % 4 );
+    }
+    
+    void operator()( const Range& range ) const {
+        const int chunk_size = 256;
+        int xs[chunk_size], ys[chunk_size];
+        float ws[chunk_size];
+        
+        const int size = static_cast<int>( grid.size() );
+        
+        for( int block = range.start; block < range.end; block++ ) {
+            const int block_end = MIN( (block + 1) * CARVE_BLOCK_SIZE, size );
+            int count = 0;
             
-            /* Then divide by the w component */
-            int x = projected_coord_ptr[0] / projected_coord_ptr[2];
-            int y = projected_coord_ptr[1] / projected_coord_ptr[2];
+            for( int start = block * CARVE_BLOCK_SIZE; start < block_end; start += chunk_size ) {
+                const int no_of_voxels = MIN( chunk_size, block_end - start );
+                projectVoxels( projection, &grid[start], no_of_voxels, xs, ys, ws );
+                
+                for( int j = 0; j < no_of_voxels; j++ ) {
+                    const int i = start + j;
+                    const int x = xs[j];
+                    const int y = ys[j];
+                    
+                    /* Only retain voxel that's in the foreground */
+                    keep[i] = x >= 0 && x < mask.cols && y >= 0 && y < mask.rows && mask.ptr<uchar>(y)[x];
+                    if( !keep[i] )
+                        continue;
+                    
+                    if( ws[j] < depths[i] ) {
+                        depths[i] = ws[j];
+                        colors[i] = image.ptr<Vec3b>(y)[x];
+                    }
+                    count++;
+                }
+            }
             
-            /* Try to clear up the voxel first */
-            if( x < 0 || x >= mask.cols || y < 0 || y >= mask.rows )
-                continue;
+            blockCounts[block] = count;
+        }
+    }
+
+private:
+    const Mat& image;
+    const Mat& mask;
+    const vector<Point3f>& grid;
+    vector<float>& depths;
+    vector<Vec3b>& colors;
+    vector<uchar>& keep;
+    vector<int>& blockCounts;
+    float projection[12];
+};
+
+/**
+ * Second half of carving a view: each block copies its retained voxels into the new arrays,
+ * starting from the offset that the prefix sum of the block counts gave it
+ */
+class BlockCompactor : public ParallelLoopBody {
+public:
+    BlockCompactor( const vector<uchar>& keep, const vector<int>& block_offsets,
+                    const vector<Point3f>& grid, const vector<float>& depths, const vector<Vec3b>& colors,
+                    vector<Point3f>& new_grid, vector<float>& new_depths, vector<Vec3b>& new_colors )
+    : keep( keep ), blockOffsets( block_offsets ), grid( grid ), depths( depths ), colors( colors ),
+      newGrid( new_grid ), newDepths( new_depths ), newColors( new_colors ) {
+    }
+    
+    void operator()( const Range& range ) const {
+        const int size = static_cast<int>( grid.size() );
+        
+        for( int block = range.start; block < range.end; block++ ) {
+            const int block_end = MIN( (block + 1) * CARVE_BLOCK_SIZE, size );
+            int k = blockOffsets[block];
             
-            /* Only retain voxel that's in the foreground */
-            if( mask.at<uchar>(y, x) ) {
-                if( projected_coord_ptr[2] < depths[i] ) {
-                    depths[i] = projected_coord_ptr[2];
-                    colors[i] = image.at<Vec3b>(y, x);
+            for( int i = block * CARVE_BLOCK_SIZE; i < block_end; i++ ) {
+                if( keep[i] ) {
+                    newGrid[k]   = grid[i];
+                    newDepths[k] = depths[i];
+                    newColors[k] = colors[i];
+                    k++;
                 }
-                
-                new_depths.push_back( depths[i] );
-                new_colors.push_back( colors[i] );
-                new_grid.push_back( voxel );
             }
         }
+    }
+
+private:
+    const vector<uchar>& keep;
+    const vector<int>& blockOffsets;
+    const vector<Point3f>& grid;
+    const vector<float>& depths;
+    const vector<Vec3b>& colors;
+    vector<Point3f>& newGrid;
+    vector<float>& newDepths;
+    vector<Vec3b>& newColors;
+};
+
+/*
+ * Perform visibility carving for several different camera viewpoints
+ */
+void VoxelGrid::carve(std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks,
+                      std::vector<cv::Mat>& projection_matrices ){
+    
+    /* The retained voxels go to the other set of arrays, which are swapped in after each view, */
+    /* so they are only allocated once */
+    vector<cv::Point3f> new_grid;
+    vector<cv::Vec3b> new_colors;
+    vector<float> new_depths;
+    
+    vector<uchar> keep;
+    vector<int> block_counts, block_offsets;
+    
+    for( int k = 0; k < projection_matrices.size(); k++ ) {
+        const int size          = static_cast<int>( grid.size() );
+        const int no_of_blocks  = (size + CARVE_BLOCK_SIZE - 1) / CARVE_BLOCK_SIZE;
+        
+        keep.resize( size );
+        block_counts.resize( no_of_blocks );
+        block_offsets.resize( no_of_blocks + 1 );
+        
+        parallel_for_( Range(0, no_of_blocks),
+                       BlockCarver( images[k], masks[k], projection_matrices[k], grid, depths, colors, keep, block_counts ) );
+        
+        /* Prefix sum of the block counts, tells each block where its voxels should go */
+        block_offsets[0] = 0;
+        for( int block = 0; block < no_of_blocks; block++ )
+            block_offsets[block + 1] = block_offsets[block] + block_counts[block];
+        
+        const int new_size = block_offsets[no_of_blocks];
+        new_grid.resize( new_size );
+        new_depths.resize( new_size );
+        new_colors.resize( new_size );
+        
+        parallel_for_( Range(0, no_of_blocks),
+                       BlockCompactor( keep, block_offsets, grid, depths, colors, new_grid, new_depths, new_colors ) );
         
         /* Update our voxel grid, colors and depth information */
-        this->grid = new_grid;
-        this->colors = new_colors;
-        this->depths = new_depths;
+        this->grid.swap( new_grid );
+        this->colors.swap( new_colors );
+        this->depths.swap( new_depths );
     }
 }
 
 /**
- * Subdivide the existing grid into higher resolution coords, and perform carving on them
+ * Subdivide the existing grid into higher resolution coords, and perform carving on them. Every voxel is replaced by
+ * its sub_division^3 children, the first of which shares its corner. The children still have to be carved against
+ * every view, since a voxel that survived can be partially outside of a silhouette; VoxelOctree avoids that by only
+ * subdividing the voxels that are on the boundary
  */
 void VoxelGrid::subDivideAndRefine( int sub_division, std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks,
                                     std::vector<cv::Mat>& projection_matrices ) {
     
-    /* Basically create a new voxel grid that contains the subdivided coordinates that weren't considered */
-    /* by the original voxel grid */
     VoxelGrid new_grid;
     new_grid.voxelSize = voxelSize / sub_division;
     
+    const size_t no_of_children = grid.size() * sub_division * sub_division * sub_division;
+    new_grid.grid.reserve( no_of_children );
+    new_grid.colors.reserve( no_of_children );
+    new_grid.depths.reserve( no_of_children );
+    
     for( int i = 0; i < grid.size(); i++ ) {
         
-        for( int x = 1; x < sub_division; x++ ) {
-            for( int y = 1; y < sub_division; y++ ) {
-                for( int z = 1; z < sub_division; z++ ) {
+        for( int x = 0; x < sub_division; x++ ) {
+            for( int y = 0; y < sub_division; y++ ) {
+                for( int z = 0; z < sub_division; z++ ) {
                     Point3f voxel = grid[i];
                     voxel.x += (x * new_grid.voxelSize);
                     voxel.y += (y * new_grid.voxelSize);
@@ -151,10 +333,11 @@ void VoxelGrid::subDivideAndRefine( int sub_division, std::vector<cv::Mat>& imag
     /* Again, perform visibility carving */
     new_grid.carve( images, masks, projection_matrices );
     
-    /* Save this newer voxel grid */
-    this->grid.insert  (this->grid.end(),   new_grid.grid.begin(),   new_grid.grid.end());
-    this->colors.insert(this->colors.end(), new_grid.colors.begin(), new_grid.colors.end());
-    this->depths.insert(this->depths.end(), new_grid.depths.begin(), new_grid.depths.end());
+    /* The children take the place of the original voxels */
+    this->voxelSize = new_grid.voxelSize;
+    this->grid.swap( new_grid.grid );
+    this->colors.swap( new_grid.colors );
+    this->depths.swap( new_grid.depths );
 }
 
 
@@ -164,7 +347,7 @@ void VoxelGrid::subDivideAndRefine( int sub_division, std::vector<cv::Mat>& imag
 void VoxelGrid::normalize() {
     Point3f min_vec(FLT_MAX, FLT_MAX, FLT_MAX);
     Point3f max_vec(FLT_MIN, FLT_MIN, FLT_MIN);
-
+    
     for( Point3f& voxel: grid ) {
         if( min_vec.x > voxel.x )
             min_vec.x = voxel.x;
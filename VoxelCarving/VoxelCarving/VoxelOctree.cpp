@@ -0,0 +1,390 @@
+//
+//  VoxelOctree.cpp
+//  VoxelCarving
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#include "VoxelOctree.h"
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <climits>
+
+using namespace std;
+using namespace cv;
+
+/* Where the bounding box of a node falls, with respect to the silhouette of a view */
+enum NodeClass {
+    NODE_OUTSIDE,
+    NODE_INSIDE,
+    NODE_BOUNDARY,
+};
+
+/**
+ * Classifies every node of an octree level against the views it's still undecided about.
+ * The bit of a view is cleared once the node is found to be inside of its silhouette,
+ * and the node is marked as carved as soon as it's outside of one
+ */
+class NodeClassifier : public ParallelLoopBody {
+public:
+    NodeClassifier( const vector<float>& projections, const vector<Mat>& sums, float extent,
+                    const vector<Point3f>& corners, vector<uint64_t>& undecided, vector<uchar>& carved )
+    : projections( projections ), sums( sums ), extent( extent ), corners( corners ), undecided( undecided ), carved( carved ) {
+    }
+    
+    void operator()( const Range& range ) const {
+        for( int i = range.start; i < range.end; i++ ) {
+            uint64_t views = undecided[i];
+            carved[i] = false;
+            
+            for( uint64_t remaining = views; remaining; remaining &= remaining - 1 ) {
+                int k = __builtin_ctzll( remaining );
+                NodeClass node_class = classify( &projections[k * 12], sums[k], corners[i] );
+                
+                if( node_class == NODE_OUTSIDE ) {
+                    carved[i] = true;
+                    break;
+                }
+                if( node_class == NODE_INSIDE )
+                    views &= ~(1ULL << k);
+            }
+            
+            undecided[i] = views;
+        }
+    }
+
+private:
+    /**
+     * Projects the corners of the box spanned by the voxels of the node, and looks up how much of the
+     * foreground the bounding rectangle covers, from the integral image of the mask. Voxel coordinates
+     * are truncated to pixels the same way VoxelGrid::carve does, so a node with a single voxel is never
+     * on the boundary, and gets the same answer as in VoxelGrid
+     */
+    inline NodeClass classify( const float * p, const Mat& sum, const Point3f& corner ) const {
+        const int cols = sum.cols - 1;
+        const int rows = sum.rows - 1;
+        
+        int x_min = INT_MAX, y_min = INT_MAX;
+        int x_max = INT_MIN, y_max = INT_MIN;
+        
+        const int no_of_corners = extent > 0.0f ? 8 : 1;
+        for( int c = 0; c < no_of_corners; c++ ) {
+            float vx = corner.x + ((c & 1) ? extent : 0.0f);
+            float vy = corner.y + ((c & 2) ? extent : 0.0f);
+            float vz = corner.z + ((c & 4) ? extent : 0.0f);
+            
+            float u = p[0] * vx + p[1] * vy + p[2]  * vz + p[3];
+            float v = p[4] * vx + p[5] * vy + p[6]  * vz + p[7];
+            float w = p[8] * vx + p[9] * vy + p[10] * vz + p[11];
+            
+            /* The box straddles the camera plane, its projection isn't bounded by its corners */
+            if( w <= 0.0f && no_of_corners > 1 )
+                return NODE_BOUNDARY;
+            
+            /* Clamped first, so that anything far off the image is still off the image once it's an int */
+            int x = static_cast<int>( MIN( MAX( u / w, -1.0f ), static_cast<float>( cols ) ) );
+            int y = static_cast<int>( MIN( MAX( v / w, -1.0f ), static_cast<float>( rows ) ) );
+            
+            x_min = MIN( x_min, x );
+            x_max = MAX( x_max, x );
+            y_min = MIN( y_min, y );
+            y_max = MAX( y_max, y );
+        }
+        
+        /* Voxels that are projected outside of the image are carved, same as the background */
+        int x0 = MAX( x_min, 0 ), x1 = MIN( x_max, cols - 1 );
+        int y0 = MAX( y_min, 0 ), y1 = MIN( y_max, rows - 1 );
+        if( x0 > x1 || y0 > y1 )
+            return NODE_OUTSIDE;
+        
+        int foreground = sum.at<int>( y1 + 1, x1 + 1 ) - sum.at<int>( y0, x1 + 1 )
+                       - sum.at<int>( y1 + 1, x0 ) + sum.at<int>( y0, x0 );
+        
+        if( foreground == 0 )
+            return NODE_OUTSIDE;
+        
+        bool clipped = x0 != x_min || x1 != x_max || y0 != y_min || y1 != y_max;
+        if( !clipped && foreground == (x1 - x0 + 1) * (y1 - y0 + 1) )
+            return NODE_INSIDE;
+        
+        return NODE_BOUNDARY;
+    }
+    
+    const vector<float>& projections;
+    const vector<Mat>& sums;
+    float extent;
+    const vector<Point3f>& corners;
+    vector<uint64_t>& undecided;
+    vector<uchar>& carved;
+};
+
+/**
+ * Keeps the color of the nearest view for each leaf, seen from the middle of its voxels
+ */
+class LeafColorer : public ParallelLoopBody {
+public:
+    LeafColorer( const vector<float>& projections, const vector<Mat>& images, const vector<Mat>& masks,
+                 const vector<Point3f>& leaves, const vector<float>& extents,
+                 vector<float>& depths, vector<Vec3b>& colors )
+    : projections( projections ), images( images ), masks( masks ), leaves( leaves ), extents( extents ),
+      depths( depths ), colors( colors ) {
+    }
+    
+    void operator()( const Range& range ) const {
+        for( int i = range.start; i < range.end; i++ ) {
+            float half_extent = extents[i] * 0.5f;
+            Point3f center( leaves[i].x + half_extent, leaves[i].y + half_extent, leaves[i].z + half_extent );
+            
+            for( size_t k = 0; k < images.size(); k++ ) {
+                const float * p = &projections[k * 12];
+                float u = p[0] * center.x + p[1] * center.y + p[2]  * center.z + p[3];
+                float v = p[4] * center.x + p[5] * center.y + p[6]  * center.z + p[7];
+                float w = p[8] * center.x + p[9] * center.y + p[10] * center.z + p[11];
+                
+                int x = static_cast<int>( MIN( MAX( u / w, -1.0f ), static_cast<float>( masks[k].cols ) ) );
+                int y = static_cast<int>( MIN( MAX( v / w, -1.0f ), static_cast<float>( masks[k].rows ) ) );
+                if( x < 0 || x >= masks[k].cols || y < 0 || y >= masks[k].rows || !masks[k].at<uchar>(y, x) )
+                    continue;
+                
+                if( w < depths[i] ) {
+                    depths[i] = w;
+                    colors[i] = images[k].at<Vec3b>(y, x);
+                }
+            }
+        }
+    }
+
+private:
+    const vector<float>& projections;
+    const vector<Mat>& images;
+    const vector<Mat>& masks;
+    const vector<Point3f>& leaves;
+    const vector<float>& extents;
+    vector<float>& depths;
+    vector<Vec3b>& colors;
+};
+
+VoxelOctree::VoxelOctree( int levels, float voxel_size, cv::Point3f voxel_origin ) :
+    levels( levels ),
+    voxelSize( voxel_size ),
+    voxelOrigin( voxel_origin ),
+    outputScale( 1.0f, 1.0f, 1.0f ),
+    outputOffset( 0.0f, 0.0f, 0.0f )
+{
+    CV_Assert( levels >= 0 && levels <= 20 );
+    
+    /* Until it's carved, the root is the only leaf */
+    leaves.push_back( voxel_origin );
+    leafLevels.push_back( 0 );
+    depths.push_back( FLT_MAX );
+    colors.push_back( Vec3b() );
+}
+
+VoxelOctree::~VoxelOctree() {
+    
+}
+
+/**
+ * Returns the corners of the leaves, in the same order as their depths and colors. Each leaf is a single corner
+ * regardless of its size, see getLeafSize(), while saveAsPLY() writes out all the voxels it covers
+ */
+vector<cv::Point3f> VoxelOctree::getGrid() {
+    vector<Point3f> grid;
+    grid.reserve( leaves.size() );
+    
+    for( Point3f& leaf: leaves )
+        grid.push_back( Point3f( leaf.x * outputScale.x + outputOffset.x,
+                                 leaf.y * outputScale.y + outputOffset.y,
+                                 leaf.z * outputScale.z + outputOffset.z ) );
+    return grid;
+}
+
+vector<float>& VoxelOctree::getDepths() {
+    return this->depths;
+}
+
+vector<cv::Vec3b>& VoxelOctree::getColors() {
+    return this->colors;
+}
+
+unsigned int VoxelOctree::getSize() {
+    return static_cast<unsigned int>( leaves.size() );
+}
+
+/**
+ * Returns the length of the sides of a leaf, before normalization
+ */
+float VoxelOctree::getLeafSize( unsigned int index ) {
+    return voxelSize * (1 << (levels - leafLevels[index]));
+}
+
+/**
+ * Returns how many voxels of the finest level the leaves cover, which is what VoxelGrid would have kept
+ */
+uint64_t VoxelOctree::getVoxelCount() {
+    uint64_t count = 0;
+    for( unsigned char level: leafLevels )
+        count += 1ULL << (3 * (levels - level));
+    return count;
+}
+
+/*
+ * Perform visibility carving for several different camera viewpoints, one level of the octree at a time.
+ * The nodes of a level are classified in parallel, then the ones that are still on the boundary of some
+ * silhouette are split into their 8 children for the next level
+ */
+void VoxelOctree::carve( std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks,
+                         std::vector<cv::Mat>& projection_matrices ) {
+    const int no_of_views = static_cast<int>( projection_matrices.size() );
+    CV_Assert( no_of_views <= 64 );
+    
+    /* Copy the projections out of the Mats, and count the foreground of the masks in integral images */
+    vector<float> projections( no_of_views * 12 );
+    vector<Mat> sums( no_of_views );
+    for( int k = 0; k < no_of_views; k++ ) {
+        Mat& projection_mat = projection_matrices[k];
+        CV_Assert( projection_mat.type() == CV_32FC1 && projection_mat.rows == 3 && projection_mat.cols == 4 );
+        for( int i = 0; i < 12; i++ )
+            projections[k * 12 + i] = projection_mat.at<float>( i / 4, i % 4 );
+        
+        Mat foreground;
+        threshold( masks[k], foreground, 0, 1, CV_THRESH_BINARY );
+        integral( foreground, sums[k], CV_32S );
+    }
+    
+    /* Start over from the root, which still has to check every view */
+    const uint64_t all_views = no_of_views == 64 ? ~0ULL : (1ULL << no_of_views) - 1;
+    vector<Point3f> corners( 1, voxelOrigin );
+    vector<uint64_t> undecided( 1, all_views );
+    vector<uchar> carved;
+    vector<float> extents;
+    
+    leaves.clear();
+    leafLevels.clear();
+    
+    for( int level = 0; !corners.empty(); level++ ) {
+        const float node_size = voxelSize * (1 << (levels - level));
+        const int size        = static_cast<int>( corners.size() );
+        carved.resize( size );
+        
+        /* The box spans the corners of the node's voxels, so it shrinks to a point at the finest level */
+        parallel_for_( Range(0, size), NodeClassifier( projections, sums, node_size - voxelSize, corners, undecided, carved ) );
+        
+        vector<Point3f> children;
+        vector<uint64_t> children_undecided;
+        const float child_size = node_size * 0.5f;
+        
+        for( int i = 0; i < size; i++ ) {
+            if( carved[i] )
+                continue;
+            
+            if( !undecided[i] ) {
+                leaves.push_back( corners[i] );
+                leafLevels.push_back( level );
+                extents.push_back( node_size - voxelSize );
+                continue;
+            }
+            
+            for( int c = 0; c < 8; c++ ) {
+                children.push_back( Point3f( corners[i].x + ((c & 1) ? child_size : 0.0f),
+                                             corners[i].y + ((c & 2) ? child_size : 0.0f),
+                                             corners[i].z + ((c & 4) ? child_size : 0.0f) ) );
+                children_undecided.push_back( undecided[i] );
+            }
+        }
+        
+        corners.swap( children );
+        undecided.swap( children_undecided );
+    }
+    
+    depths.assign( leaves.size(), FLT_MAX );
+    colors.assign( leaves.size(), Vec3b() );
+    parallel_for_( Range(0, static_cast<int>( leaves.size() )),
+                   LeafColorer( projections, images, masks, leaves, extents, depths, colors ) );
+}
+
+/**
+ * Normalize the voxel coordinates, so they stay between -1.0 an 1.0
+ */
+void VoxelOctree::normalize() {
+    if( leaves.empty() )
+        return;
+    
+    Point3f min_vec( FLT_MAX, FLT_MAX, FLT_MAX );
+    Point3f max_vec( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+    
+    for( size_t i = 0; i < leaves.size(); i++ ) {
+        /* Same as the corners of the voxels that the leaf covers */
+        float extent = getLeafSize( static_cast<unsigned int>( i ) ) - voxelSize;
+        min_vec = Point3f( MIN( min_vec.x, leaves[i].x ), MIN( min_vec.y, leaves[i].y ), MIN( min_vec.z, leaves[i].z ) );
+        max_vec = Point3f( MAX( max_vec.x, leaves[i].x + extent ),
+                           MAX( max_vec.y, leaves[i].y + extent ),
+                           MAX( max_vec.z, leaves[i].z + extent ) );
+    }
+    
+    Point3f length = (max_vec - min_vec) * 0.5;
+    
+    /* A single layer of voxels just ends up at -1.0 */
+    outputScale  = Point3f( length.x > 0 ? 1.0f / length.x : 1.0f,
+                            length.y > 0 ? 1.0f / length.y : 1.0f,
+                            length.z > 0 ? 1.0f / length.z : 1.0f );
+    outputOffset = Point3f( -min_vec.x * outputScale.x - 1.0f,
+                            -min_vec.y * outputScale.y - 1.0f,
+                            -min_vec.z * outputScale.z - 1.0f );
+}
+
+/**
+ * Save the carved octree as a PLY model file. Every leaf is expanded into the voxels of the finest level that it
+ * covers, all with the leaf's color, so the model has the same vertices as VoxelGrid's at that resolution
+ */
+void VoxelOctree::saveAsPLY( const std::string filename ) {
+    ofstream output( filename );
+    
+    uint64_t size = getVoxelCount();
+    
+    output << "ply" << endl;
+    output << "format ascii 1.0" << endl;
+    output << "element vertex " << size << endl;
+    output << "property float x" << endl;
+    output << "property float y" << endl;
+    output << "property float z" << endl;
+    output << "property uchar red" << endl;
+    output << "property uchar green" << endl;
+    output << "property uchar blue" << endl;
+    output << "element face " << size / 3 << endl;
+    output << "property list uchar int vertex_indices" << endl;
+    output << "end_header" << endl;
+    
+    /* Write vertex and vertex color */
+    for( size_t i = 0; i < leaves.size(); i++ ) {
+        const int side = 1 << (levels - leafLevels[i]);
+        Vec3b& color = colors[i];
+        
+        for( int x = 0; x < side; x++ ) {
+            for( int y = 0; y < side; y++ ) {
+                for( int z = 0; z < side; z++ ) {
+                    Point3f voxel = leaves[i] + Point3f( x, y, z ) * voxelSize;
+                    output  << voxel.x * outputScale.x + outputOffset.x << " "
+                            << voxel.y * outputScale.y + outputOffset.y << " "
+                            << voxel.z * outputScale.z + outputOffset.z << " ";
+                    
+                    output  << static_cast<int>(color[2]) << " "
+                            << static_cast<int>(color[1]) << " "
+                            << static_cast<int>(color[0]) << endl;
+                }
+            }
+        }
+    }
+    
+    /* Write the faces */
+    for( uint64_t i = 0; i + 2 < size; i += 3 )  {
+        output  << "3 " << i
+                << " "  << (i + 1)
+                << " "  << (i + 2) << endl;
+    }
+    
+    output.close();
+}
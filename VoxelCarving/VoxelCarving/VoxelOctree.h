@@ -0,0 +1,60 @@
+//
+//  VoxelOctree.h
+//  VoxelCarving
+//
+//  Created by Saburo Okita on 19/10/26.
+//  Copyright (c) 2026 Saburo Okita. All rights reserved.
+//
+
+#ifndef __VoxelCarving__VoxelOctree__
+#define __VoxelCarving__VoxelOctree__
+
+#include <iostream>
+#include <stdint.h>
+#include <opencv2/opencv.hpp>
+
+/**
+ * Hierarchical voxel carving, over an octree whose root is a cube of 2^levels voxels on each side.
+ * Instead of projecting every voxel, each node projects its bounding box to the silhouettes: nodes that fall
+ * completely outside of a silhouette are carved away, nodes that fall completely inside of all of them are kept
+ * as leaves, and only the nodes on the boundary of a silhouette are subdivided. A child only checks the views
+ * that its parent was on the boundary of, so the work grows with the surface of the model, not its volume.
+ *
+ * Like VoxelGrid, a voxel is represented by its corner, and the leaves cover the same voxels that
+ * VoxelGrid::carve keeps at the finest resolution
+ */
+class VoxelOctree {
+public:
+    VoxelOctree( int levels, float voxel_size, cv::Point3f voxel_origin );
+    ~VoxelOctree();
+    
+    std::vector<cv::Point3f> getGrid();
+    std::vector<float>& getDepths();
+    std::vector<cv::Vec3b>& getColors();
+    unsigned int getSize();
+    float getLeafSize( unsigned int index );
+    uint64_t getVoxelCount();
+    
+    void carve( std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks, std::vector<cv::Mat>& projection_matrices );
+    void normalize();
+    
+    void saveAsPLY( const std::string filename );
+
+protected:
+    int levels;
+    float voxelSize;
+    cv::Point3f voxelOrigin;
+    
+    /* Output coordinates are voxel coordinates * outputScale + outputOffset, changed by normalize() */
+    cv::Point3f outputScale;
+    cv::Point3f outputOffset;
+    
+    /* Corner of each leaf, and how many times the root was subdivided to get to it */
+    std::vector<cv::Point3f> leaves;
+    std::vector<unsigned char> leafLevels;
+    
+    std::vector<float> depths;
+    std::vector<cv::Vec3b> colors;
+};
+
+#endif /* defined(__VoxelCarving__VoxelOctree__) */
@@ -13,6 +13,8 @@
 
 #include <opencv2/opencv.hpp>
 #include "VoxelGrid.h"
+#include "DenseVoxelGrid.h"
+#include "VoxelOctree.h"
 
 using namespace std;
 using namespace cv;
@@ -68,6 +70,30 @@ int main(int argc, const char * argv[])
     cout << "Performing voxel carving" << endl;
     VoxelGrid grid(100, 100, 100, 800.0 / 100.0, Point3f( -100.0, -100.0, -100.0) );
     grid.carve( images, masks, projection_matrices );
+    
+    /* The dense grid keeps the same voxels with less memory, the counts only differ by rounding on pixel borders */
+    DenseVoxelGrid dense_grid(100, 100, 100, 800.0 / 100.0, Point3f( -100.0, -100.0, -100.0) );
+    dense_grid.carve( images, masks, projection_matrices );
+    cout << "VoxelGrid kept " << grid.getSize() << " voxels, DenseVoxelGrid kept " << dense_grid.getSize() << endl;
+    
+    /* The octree keeps the same voxels as a 128^3 grid over the same volume, but only subdivides the nodes */
+    /* on the boundaries of the silhouettes */
+    int64 start = getTickCount();
+    VoxelGrid fine_grid(128, 128, 128, 800.0 / 128.0, Point3f( -100.0, -100.0, -100.0) );
+    fine_grid.carve( images, masks, projection_matrices );
+    double grid_elapsed = (getTickCount() - start) / getTickFrequency();
+    
+    start = getTickCount();
+    VoxelOctree octree(7, 800.0 / 128.0, Point3f( -100.0, -100.0, -100.0) );
+    octree.carve( images, masks, projection_matrices );
+    double octree_elapsed = (getTickCount() - start) / getTickFrequency();
+    
+    cout << "VoxelGrid kept " << fine_grid.getSize() << " voxels in " << grid_elapsed << "s, "
+         << "VoxelOctree kept " << octree.getVoxelCount() << " voxels as " << octree.getSize() << " leaves in " << octree_elapsed << "s" << endl;
+    
+    octree.normalize();
+    octree.saveAsPLY( path + "morpheus/morpheus_octree.ply");
+    
     grid.subDivideAndRefine(2, images, masks, projection_matrices );
     grid.normalize();
     